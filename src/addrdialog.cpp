@@ -56,7 +56,7 @@ addrDialog::addrDialog(QWidget* parent, bool partial, Qt::WindowFlags fl)
     else
         resize(1000,1000);
     if (bPartial) {
-        ui.nameTreeView->hide();
+        ui.siteWidget->hide();
         ui.connectPushButton->hide();
         ui.closePushButton->setText(tr("Cancel"));
         ui.applyPushButton->setText(tr("OK"));
@@ -69,7 +69,8 @@ addrDialog::addrDialog(QWidget* parent, bool partial, Qt::WindowFlags fl)
     } else {
         setWindowTitle(tr("AddressBook"));
 		
-        QDomDocument doc = Global::instance()->addrXml();
+        // edited apart from the cached address book until saved
+        QDomDocument doc = Global::instance()->addrXml().cloneNode(true).toDocument();
         domModel = new DomModel(doc);
         ui.nameTreeView->setModel(domModel);
 
@@ -215,8 +216,10 @@ void addrDialog::onNamechange(const QModelIndex & index)
             updateData(true);
 			if (lastIndex.isValid()) {
 				QString uuid = domModel->data(lastIndex,Qt::UserRole).toString();
-				if (!QUuid(uuid).isNull())
+				if (!QUuid(uuid).isNull()) {
 					Global::instance()->saveAddress(domModel->document(), uuid, param);
+					domModel->updateSite(uuid);
+				}
             }
         }
     }
@@ -232,8 +235,10 @@ void addrDialog::onApply()
     updateData(true);
     if (!bPartial) {
 		QString uuid = domModel->data(lastIndex,Qt::UserRole).toString();
-		if (!uuid.isEmpty())
+		if (!uuid.isEmpty()) {
 			Global::instance()->saveAddress(domModel->document(), uuid, param);
+			domModel->updateSite(uuid);
+		}
 		Global::instance()->saveAddressXml(domModel->document());
     } else
         done(1);
@@ -264,6 +269,49 @@ void addrDialog::onConnect(const QModelIndex & index)
     done(1);
 }
 
+// hide the sites not matching, the best match becomes current
+void addrDialog::onFilter(const QString & text)
+{
+    QStringList found = domModel->search(text);
+    QSet<QString> visible = found.toSet();
+    QModelIndex best;
+    filterRows(QModelIndex(), text.trimmed().isEmpty() ? NULL : &visible,
+               found.isEmpty() ? QString() : found.first(), best);
+    if (!text.trimmed().isEmpty())
+        ui.nameTreeView->expandAll();
+    if (best.isValid())
+        ui.nameTreeView->setCurrentIndex(best);
+}
+
+// load the current match, the default button then connects to it
+void addrDialog::onFilterReturn()
+{
+    QModelIndex index = ui.nameTreeView->currentIndex();
+    if (index.isValid() && !ui.nameTreeView->isRowHidden(index.row(), index.parent()))
+        onNamechange(index);
+}
+
+bool addrDialog::filterRows(const QModelIndex & parent, const QSet<QString> * visible,
+                            const QString & bestUuid, QModelIndex & best)
+{
+    bool any = false;
+    for (int row = 0; row < domModel->rowCount(parent); row++) {
+        QModelIndex index = domModel->index(row, 0, parent);
+        bool show;
+        if (domModel->type(index) == DomModel::Folder) {
+            show = filterRows(index, visible, bestUuid, best) || visible == NULL;
+        } else {
+            QString uuid = domModel->data(index, Qt::UserRole).toString();
+            show = visible == NULL || visible->contains(uuid);
+            if (!best.isValid() && uuid == bestUuid)
+                best = index;
+        }
+        ui.nameTreeView->setRowHidden(row, parent, !show);
+        any = any || show;
+    }
+    return any;
+}
+
 void addrDialog::onReset()
 {
     updateData(false);
@@ -379,6 +427,10 @@ void addrDialog::connectSlots()
     connect(ui.nameTreeView, SIGNAL(clicked(QModelIndex)), this, SLOT(onNamechange(QModelIndex)));
     connect(ui.nameTreeView, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(onConnect(QModelIndex)));
 	connect(ui.nameTreeView, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(onPopupTreeContextMenu(QPoint)));
+    if (!bPartial) {
+        connect(ui.filterLineEdit, SIGNAL(textChanged(QString)), this, SLOT(onFilter(QString)));
+        connect(ui.filterLineEdit, SIGNAL(returnPressed()), this, SLOT(onFilterReturn()));
+    }
 
     connect(ui.applyPushButton, SIGNAL(clicked()), this, SLOT(onApply()));
     connect(ui.closePushButton, SIGNAL(clicked()), this, SLOT(onClose()));
@@ -444,6 +496,7 @@ bool addrDialog::isChanged()
 //  param.m_mapParam["retrytimes"].toInt() != ui.retryLineEdit->text().toInt() ||
            param.m_mapParam["loadscript"].toBool() != ui.scriptCheckBox->isChecked() ||
            param.m_mapParam["scriptfile"].toString() != ui.scriptLineEdit->text() ||
+           param.m_mapParam["triggers"].toString() != ui.triggerTextEdit->toPlainText() ||
            param.m_mapParam["menutype"].toInt() != ui.menuTypeComboBox->currentIndex() ||
            param.m_mapParam["menucolor"] != clrMenu) ||
            param.m_mapParam["sshuser"].toString() != ui.sshUserLineEdit->text() ||
@@ -503,6 +556,7 @@ void addrDialog::updateData(bool save)
 //  param.m_mapParam["retrytimes"] = ui.retryLineEdit->text().toInt();
         param.m_mapParam["loadscript"] = ui.scriptCheckBox->isChecked();
         param.m_mapParam["scriptfile"] = ui.scriptLineEdit->text();
+        param.m_mapParam["triggers"] = ui.triggerTextEdit->toPlainText();
         param.m_mapParam["menutype"] = ui.menuTypeComboBox->currentIndex();
         param.m_mapParam["menucolor"] = clrMenu;
         param.m_mapParam["sshuser"] = ui.sshUserLineEdit->text();
@@ -580,6 +634,7 @@ void addrDialog::updateData(bool save)
         ui.scriptLineEdit->setEnabled(param.m_mapParam["loadscript"].toBool());
         ui.scriptPushButton->setEnabled(param.m_mapParam["loadscript"].toBool());
         ui.scriptLineEdit->setText(param.m_mapParam["scriptfile"].toString());
+        ui.triggerTextEdit->setPlainText(param.m_mapParam["triggers"].toString());
         ui.menuTypeComboBox->setCurrentIndex(param.m_mapParam["menutype"].toInt());
         //ui.menuGroup->setButton(param.m_nMenuType);
         //QRadioButton * rbMenu = qobject_cast<QRadioButton*>(bgMenu.button(param.m_nMenuType));
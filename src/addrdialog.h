@@ -12,6 +12,7 @@
 #include "qtermparam.h"
 #include "ui_addrdialog.h"
 #include <QButtonGroup>
+#include <QtCore/QSet>
 namespace QTerm
 {
 class Config;
@@ -46,6 +47,8 @@ protected slots:
     void onGeneralFont(const QFont & font);
     void onFontSize(int size);
 	void onPopupTreeContextMenu(const QPoint& point);
+    void onFilter(const QString & text);
+    void onFilterReturn();
 protected:
     void connectSlots();
     bool isChanged();
@@ -54,6 +57,8 @@ protected:
     void updateSchemeList();
     void updateComboBoxes();
     void updateKeyboardProfiles();
+    bool filterRows(const QModelIndex & parent, const QSet<QString> * visible,
+                    const QString & bestUuid, QModelIndex & best);
 
     bool bPartial;
     QString strASCIIFontName;
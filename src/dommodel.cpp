@@ -139,9 +139,16 @@ int DomItem::row()
 }
 
 DomModel::DomModel(QDomDocument document, QObject *parent)
-    : QAbstractItemModel(parent), domDocument(document)
+    : QAbstractItemModel(parent), domDocument(document), siteElements(), siteTotal(0), siteIndex()
 {
     rootItem = new DomItem(document.documentElement());
+    QDomNodeList siteList = domDocument.elementsByTagName("site");
+    siteTotal = siteList.count();
+    for (int i=0; i<siteTotal; i++) {
+        QDomElement element = siteList.item(i).toElement();
+        siteElements.insert(element.attribute("uuid"), element);
+    }
+    siteIndex.build(domDocument);
 }
 
 DomModel::~DomModel()
@@ -149,6 +156,23 @@ DomModel::~DomModel()
     delete rootItem;
 }
 
+QDomElement DomModel::site(const QString &uuid) const
+{
+    return siteElements.value(uuid);
+}
+
+QStringList DomModel::search(const QString &text) const
+{
+    return siteIndex.search(text, -1);
+}
+
+void DomModel::updateSite(const QString &uuid)
+{
+    QDomElement element = site(uuid);
+    if (!element.isNull())
+        siteIndex.setSite(element);
+}
+
 int DomModel::columnCount(const QModelIndex &/*parent*/) const
 {
     return 1;
@@ -169,6 +193,8 @@ QVariant DomModel::data(const QModelIndex &index, int role) const
             }
         break;
         case Qt::DisplayRole:
+            if (item->isSiteReference())
+                return site(item->uuid()).attribute("name");
             return item->name();
         break;
         case Qt::DecorationRole:
@@ -253,17 +279,13 @@ DomModel::ItemType DomModel::type(const QModelIndex &index) const
     if (item->isFolder())
         return Folder;
     else if (item->isSiteReference()) {
-        QString uuid = data(index, Qt::UserRole).toString();
         // get favor attributes
-        QDomNodeList siteList = domDocument.elementsByTagName("site");
-        for (int i=0; i<siteList.count(); i++) {
-            QDomElement element = siteList.item(i).toElement();
-            if (element.attribute("uuid") == uuid) {
-                if (element.attribute("favor") == "1")
-                    return Favorite;
-                else
-                    return Site;
-            }
+        QDomElement element = site(item->uuid());
+        if (!element.isNull()) {
+            if (element.attribute("favor") == "1")
+                return Favorite;
+            else
+                return Site;
         }
     }
     return Unknown;
@@ -278,7 +300,7 @@ int DomModel::rowCount(const QModelIndex &parent) const
     int sitesCount = 0; // This is the number of site elements of root item
     if (!parent.isValid()) {
         parentItem = rootItem;
-        sitesCount = domDocument.elementsByTagName("site").count();
+        sitesCount = siteTotal;
     }
     else
         parentItem = static_cast<DomItem*>(parent.internalPointer());
@@ -455,15 +477,12 @@ void DomModel::toggleFavorite(const QModelIndex &index)
     if (QUuid(uuid).isNull())
         return;
     // toggle favor attributes
-    QDomNodeList siteList = domDocument.elementsByTagName("site");
-    for (int i=0; i<siteList.count(); i++) {
-        QDomElement element = siteList.item(i).toElement();
-        if (element.attribute("uuid") == uuid) {
-            if (element.attribute("favor") == "1")
-                element.setAttribute("favor", 0);
-            else
-                element.setAttribute("favor", 1);
-        }
+    QDomElement element = site(uuid);
+    if (!element.isNull()) {
+        if (element.attribute("favor") == "1")
+            element.setAttribute("favor", 0);
+        else
+            element.setAttribute("favor", 1);
     }
 }
 
@@ -476,16 +495,15 @@ void DomModel::addSite(const QModelIndex &index)
         uuid = data(index, Qt::UserRole).toString();
     else
         uuid = QUuid().toString();
-    QDomNodeList siteList = domDocument.elementsByTagName("site");
-    for (int i=0; i<siteList.count(); i++) {
-        QDomElement site = siteList.item(i).toElement();
-        if (site.attribute("uuid") == uuid) {
-            QDomElement newSite = site.cloneNode().toElement();
-            newSite.setAttribute("uuid", newUuid);
-            QDomElement root = domDocument.documentElement();
-            root.appendChild(newSite);
-            break;
-        }
+    QDomElement element = site(uuid);
+    if (!element.isNull()) {
+        QDomElement newSite = element.cloneNode().toElement();
+        newSite.setAttribute("uuid", newUuid);
+        QDomElement root = domDocument.documentElement();
+        root.appendChild(newSite);
+        siteElements.insert(newUuid, newSite);
+        siteTotal++;
+        siteIndex.setSite(newSite);
     }
     // Create site reference
     QDomElement newSiteRef = domDocument.createElement("addsite");
@@ -515,15 +533,13 @@ void DomModel::removeItem(const QModelIndex &index)
     }
     else {
         QString uuid = data(index, Qt::UserRole).toString();
-        QDomNodeList nodeList;
         // remove the actual site
-                nodeList = domDocument.documentElement().elementsByTagName("site");
-        for (int i=0; i<nodeList.count(); i++) {
-            QDomElement node = nodeList.at(i).toElement();
-            if (uuid == node.attribute("uuid")) {
-                                domDocument.documentElement().removeChild(node);
-            }
+        QDomElement node = siteElements.take(uuid);
+        if (!node.isNull() && node.parentNode() == domDocument.documentElement()) {
+            domDocument.documentElement().removeChild(node);
+            siteTotal--;
         }
+        siteIndex.removeSite(uuid);
         // and its reference in folder
         removeRows(index.row(), 1, index.parent());
     }
@@ -8,6 +8,8 @@
 #include <QtXml/QDomElement>
 #include <QHash>
 
+#include "qtermsiteindex.h"
+
 namespace QTerm
 {
 class DomItem
@@ -78,9 +80,20 @@ public:
 
     QDomDocument document() { return domDocument; }
 
+    // uuids of the sites best matching text
+    QStringList search(const QString &text) const;
+    // after the attributes of a site are changed outside the model
+    void updateSite(const QString &uuid);
+
 private:
+    QDomElement site(const QString &uuid) const;
+
     QDomDocument domDocument;
     DomItem *rootItem;
+    // sites by uuid, they all sit at the end of the root element
+    QHash<QString, QDomElement> siteElements;
+    int siteTotal;
+    SiteIndex siteIndex;
 };
 } // namespace QTerm
 #endif //DOMMODEL_H
@@ -0,0 +1,106 @@
+#include "qtermarticle.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+namespace QTerm
+{
+
+#if defined(_OS_WIN32_) || defined(Q_OS_WIN32)
+static const char LineBreak[] = "\r\n";
+#else
+static const char LineBreak[] = "\n";
+#endif
+
+static const quint64 Base = Q_UINT64_C(0x100000001b3);
+
+static inline quint64 lineHash(const QString & line)
+{
+    return (quint64(qHash(line)) << 32) | uint(line.length());
+}
+
+ArticleCapture::ArticleCapture()
+    : m_file(), m_text(), m_stream(), m_count(0), m_tail(), m_tailHash()
+{
+    if (m_file.open())
+        m_stream.setDevice(&m_file);
+    else
+        m_stream.setString(&m_text);
+    m_stream.setCodec("UTF-8");
+}
+
+ArticleCapture::~ArticleCapture()
+{
+}
+
+QString ArticleCapture::stripRight(const QString & line)
+{
+    int n = line.length();
+    while (n > 0 && line.at(n - 1).isSpace())
+        n--;
+    return line.left(n);
+}
+
+void ArticleCapture::addPage(const QStringList & page)
+{
+    QVector<quint64> hashes(page.size());
+    for (int i = 0; i < page.size(); i++)
+        hashes[i] = lineHash(page.at(i));
+
+    // k lines overlap when the hash of the first k lines of the page
+    // equals that of the last k lines kept
+    QList<int> candidates;
+    quint64 head = 0;
+    quint64 tail = 0;
+    quint64 power = 1;
+    int n = qMin(m_tail.size(), page.size());
+    for (int k = 1; k <= n; k++) {
+        head = head * Base + hashes.at(k - 1);
+        tail = m_tailHash.at(m_tail.size() - k) * power + tail;
+        power *= Base;
+        if (head == tail)
+            candidates << k;
+    }
+    int overlap = 0;
+    while (overlap == 0 && !candidates.isEmpty()) {
+        int k = candidates.takeLast();
+        int i = 0;
+        while (i < k && m_tail.at(m_tail.size() - k + i) == page.at(i))
+            i++;
+        if (i == k)
+            overlap = k;
+    }
+
+    for (int i = overlap; i < page.size(); i++) {
+        m_tail << page.at(i);
+        m_tailHash << hashes.at(i);
+    }
+    while (m_tail.size() > page.size()) {
+        writeLine(m_tail.takeFirst());
+        m_tailHash.removeFirst();
+    }
+}
+
+QString ArticleCapture::finish()
+{
+    while (!m_tail.isEmpty())
+        writeLine(m_tail.takeFirst());
+    m_tailHash.clear();
+    m_stream.flush();
+    if (m_stream.string() != NULL)
+        return m_text;
+
+    m_file.seek(0);
+    QTextStream in(&m_file);
+    in.setCodec("UTF-8");
+    return in.readAll();
+}
+
+void ArticleCapture::writeLine(const QString & line)
+{
+    if (m_count++ > 0)
+        m_stream << LineBreak;
+    m_stream << line;
+}
+
+} // namespace QTerm
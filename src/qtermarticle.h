@@ -0,0 +1,48 @@
+#ifndef QTERMARTICLE_H
+#define QTERMARTICLE_H
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QTextStream>
+
+namespace QTerm
+{
+
+/*
+ * Collects an article page by page.  Consecutive pages usually overlap,
+ * the longest run of lines that ends the text so far and starts the new
+ * page is dropped from the page.  Lines are compared by hash, and the hash
+ * of every candidate run is rolled on from the previous one, so a page
+ * costs time linear in its height however long the article is.
+ *
+ * Only the last page is kept in memory, older lines are streamed to a
+ * temporary file until finish().
+ */
+class ArticleCapture
+{
+public:
+    ArticleCapture();
+    ~ArticleCapture();
+
+    // lines of a page, trailing white space already stripped
+    void addPage(const QStringList & page);
+    QString finish();
+
+    static QString stripRight(const QString & line);
+
+private:
+    void writeLine(const QString & line);
+
+    QTemporaryFile m_file;
+    QString m_text;     // used if the file could not be created
+    QTextStream m_stream;
+    int m_count;
+    QStringList m_tail;
+    QList<quint64> m_tailHash;
+};
+
+} // namespace QTerm
+
+#endif // QTERMARTICLE_H
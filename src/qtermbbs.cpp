@@ -28,7 +28,12 @@
 namespace QTerm
 {
 BBS::BBS(Buffer * buffer)
-    :m_urlPosList()
+    :m_urlPosList(),
+     m_schemeRe("(mailto:|(https?|mms|rstp|ftp|gopher|telnet|ed2k|file)://)"),
+     m_emailRe("^[A-Z0-9._%-]+@[A-Z0-9.-]+\\.[A-Z]{2,4}", Qt::CaseInsensitive),
+     m_ipRe("(?:(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)\\.){3}(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?|\\*)"),
+     m_lineInfo(), m_lineColumns(0), m_generation(0),
+     m_pageGeneration(-1), m_selLine(NULL), m_selRevision(0)
 {
     m_pBuffer = buffer;
 #ifdef SCRIPT_ENABLED
@@ -98,17 +103,13 @@ QString BBS::getMessage()
 void BBS::setPageState()
 {
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL) {
+    if (m_scriptEngine != NULL && m_scriptHelper->hasHook(ScriptHelper::SetPageState)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("setPageState");
-        if (func.isFunction()) {
-            int ret = func.call().toInt32();
-            if (m_scriptHelper->accepted()) {
-                m_nPageState = ret;
-                return;
-            }
-        } else {
-            qDebug("setPageState is not a function");
+        int ret = m_scriptHelper->callHook(ScriptHelper::SetPageState).toInt32();
+        if (m_scriptHelper->accepted()) {
+            m_nPageState = ret;
+            m_pageGeneration = -1;
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -117,21 +118,26 @@ void BBS::setPageState()
     }
 #endif
 
+    syncLines();
+    if (m_pageGeneration == m_generation)
+        return;
+    m_pageGeneration = m_generation;
+
     m_nPageState = -1;
 
     TextLine * line;
 //  Q3CString color;
 
-    line = m_pBuffer->screen(0);    // first line
-    if (isUnicolor(line)) {
-        line = m_pBuffer->screen(2);    // third line
-        if (isUnicolor(line))
+    if (m_lineInfo.size() < 3)
+        return;
+    if (m_lineInfo[0].unicolor) {   // first line
+        if (m_lineInfo[2].unicolor)   // third line
             m_nPageState = 1; //board and article list
         else
             m_nPageState = 0; //menu
     } else {
         line = m_pBuffer->screen(m_pBuffer->line() - 1);  // last line
-        if (isUnicolor(line)) {
+        if (m_lineInfo.last().unicolor) {
             if (line->getText().indexOf("Ctrl-Q")!=-1 || line->getText().indexOf("^X/^Q")!=-1)
                 m_nPageState = 4; // editing
             else
@@ -149,19 +155,14 @@ int BBS::getCursorType(const QPoint& pt)
 
     int nCursorType = 9;
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL) {
+    if (m_scriptEngine != NULL && m_scriptHelper->hasHook(ScriptHelper::SetCursorType)) {
         m_scriptHelper->setAccepted(false);
         TextLine * line = m_pBuffer->at(pt.y());
         int x = pt.x();
         int y = pt.y() - m_nScreenStart;
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("setCursorType");
-        if (func.isFunction()) {
-            int ret = func.call(QScriptValue(), QScriptValueList() << x << y).toInt32();
-            if (m_scriptHelper->accepted()) {
-                return ret;
-            }
-        } else {
-            qDebug("setCursorType is not a function");
+        int ret = m_scriptHelper->callHook(ScriptHelper::SetCursorType, QScriptValueList() << x << y).toInt32();
+        if (m_scriptHelper->accepted()) {
+            return ret;
         }
     }
 #endif
@@ -258,6 +259,19 @@ void BBS::updateSelectRect()
 {
     QRect rect(0, 0, 0, 0);
 
+    // nothing the selection depends on has changed
+    TextLine *cursorLine = m_pBuffer->at(m_ptCursor.y());
+    bool unchanged = cursorLine != NULL && cursorLine == m_selLine
+            && cursorLine->revision() == m_selRevision
+            && m_ptCursor == m_selCursor && m_nPageState == m_selPageState
+            && m_nScreenStart == m_selScreenStart && m_pBuffer->lines() == m_selLines;
+#ifdef SCRIPT_ENABLED
+    // a script choosing the selection may look at anything on the screen
+    unchanged = unchanged && (m_scriptEngine == NULL || !m_scriptHelper->hasHook(ScriptHelper::SetSelectRect));
+#endif
+    if (unchanged)
+        return;
+
 	TextLine *line = m_pBuffer->at(m_rcSelection.y());
 	if (line == NULL)
 		return;
@@ -269,24 +283,19 @@ void BBS::updateSelectRect()
     }
 
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL) {
+    if (m_scriptEngine != NULL && m_scriptHelper->hasHook(ScriptHelper::SetSelectRect)) {
         m_scriptHelper->setAccepted(false);
         rect.setRect(0,0,0,0);
         int x = m_ptCursor.x();
         int y = m_ptCursor.y() - m_nScreenStart;
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("setSelectRect");
-        if (func.isFunction()) {
-            QScriptValue rectArray = func.call(QScriptValue(), QScriptValueList() << x << y);
-            if (m_scriptHelper->accepted() && rectArray.isArray()) {
-                rect.setX(rectArray.property(0).toInteger()); // x
-                rect.setY(rectArray.property(1).toInteger() + m_nScreenStart); //y
-                rect.setWidth(rectArray.property(2).toInteger());
-                rect.setHeight(rectArray.property(3).toInteger());
-                m_rcSelection = rect;
-                return;
-            }
-        } else {
-            qDebug("setSelectRect is not a function");
+        QScriptValue rectArray = m_scriptHelper->callHook(ScriptHelper::SetSelectRect, QScriptValueList() << x << y);
+        if (m_scriptHelper->accepted() && rectArray.isArray()) {
+            rect.setX(rectArray.property(0).toInteger()); // x
+            rect.setY(rectArray.property(1).toInteger() + m_nScreenStart); //y
+            rect.setWidth(rectArray.property(2).toInteger());
+            rect.setHeight(rectArray.property(3).toInteger());
+            m_rcSelection = rect;
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -363,6 +372,14 @@ void BBS::updateSelectRect()
 
 
     m_rcSelection = rect;
+
+    // taken last, the line may just have been marked for repaint
+    m_selLine = cursorLine;
+    m_selRevision = cursorLine != NULL ? cursorLine->revision() : 0;
+    m_selCursor = m_ptCursor;
+    m_selPageState = m_nPageState;
+    m_selScreenStart = m_nScreenStart;
+    m_selLines = m_pBuffer->lines();
 }
 
 QRect BBS::getSelectRect()
@@ -388,8 +405,16 @@ bool BBS::isUnicolor(TextLine *line)
 
 bool BBS::isIllChar(QChar ch)
 {
-    static QString illChars = ",;'\"()<>^[]";
-    return ch > '~' || ch < '#' || illChars.contains(ch);
+    ushort c = ch.unicode();
+    if (c > '~' || c < '#')
+        return true;
+    switch (c) {
+    case ',': case ';': case '\'': case '(': case ')':
+    case '<': case '>': case '^': case '[': case ']':
+        return true;
+    default:
+        return false;
+    }
 }
 
 bool BBS::isUrl(QRect& rcUrl, QRect& rcOld)
@@ -406,20 +431,15 @@ bool BBS::checkUrl(QRect & rcUrl, QRect & rcOld)
 {
     m_strUrl = "";
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL) {
+    if (m_scriptEngine != NULL && m_scriptHelper->hasHook(ScriptHelper::CheckUrl)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("checkUrl");
-        if (func.isFunction()) {
-            QString url= func.call(QScriptValue(), QScriptValueList() << m_ptCursor.x() << m_ptCursor.y()-m_nScreenStart).toString();
-            if (m_scriptHelper->accepted()) {
-                if (url.isEmpty()) {
-                    return false;
-                }
-                m_strUrl = url;
-                return true;
+        QString url= m_scriptHelper->callHook(ScriptHelper::CheckUrl, QScriptValueList() << m_ptCursor.x() << m_ptCursor.y()-m_nScreenStart).toString();
+        if (m_scriptHelper->accepted()) {
+            if (url.isEmpty()) {
+                return false;
             }
-        } else {
-            qDebug("checkUrl is not a function");
+            m_strUrl = url;
+            return true;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -434,10 +454,8 @@ bool BBS::checkUrl(QRect & rcUrl, QRect & rcOld)
             if (pt > url.first && pt < url.second) {
                 //qDebug() << "get text: " << getText(url.first, url.second);
                 m_strUrl = getText(url.first, url.second);
-                QRegExp urlRe("(mailto:|(https?|mms|rstp|ftp|gopher|telnet|ed2k|file)://)");
-                QRegExp emailRe("^[A-Z0-9._%-]+@[A-Z0-9.-]+\\.[A-Z]{2,4}");
-                if (urlRe.indexIn(m_strUrl)==-1) {
-                    if (emailRe.indexIn(m_strUrl)==-1) {
+                if (m_schemeRe.indexIn(m_strUrl)==-1) {
+                    if (m_emailRe.indexIn(m_strUrl)==-1) {
                         m_strUrl = "http://"+m_strUrl;
                     } else {
                         m_strUrl = "mailto:"+m_strUrl;
@@ -450,25 +468,19 @@ bool BBS::checkUrl(QRect & rcUrl, QRect & rcOld)
     return false;
 }
 
-// TODO: I do not know whether we need to support ip addr in multiple lines
-// TODO: Further Simplification
+// An address wrapped at the right margin is found from either line.
 bool BBS::checkIP(QRect& rcUrl, QRect& rcOld)
 {
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL) {
+    if (m_scriptEngine != NULL && m_scriptHelper->hasHook(ScriptHelper::CheckIP)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("checkIP");
-        if (func.isFunction()) {
-            QString ipAddr= func.call(QScriptValue(), QScriptValueList() << m_ptCursor.x() << m_ptCursor.y()-m_nScreenStart).toString();
-            if (m_scriptHelper->accepted()) {
-                if (ipAddr.isEmpty()) {
-                    return false;
-                }
-                m_strIP = ipAddr;
-                return true;
+        QString ipAddr= m_scriptHelper->callHook(ScriptHelper::CheckIP, QScriptValueList() << m_ptCursor.x() << m_ptCursor.y()-m_nScreenStart).toString();
+        if (m_scriptHelper->accepted()) {
+            if (ipAddr.isEmpty()) {
+                return false;
             }
-        } else {
-            qDebug("checkIP is not a function");
+            m_strIP = ipAddr;
+            return true;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -476,11 +488,13 @@ bool BBS::checkIP(QRect& rcUrl, QRect& rcOld)
         }
     }
 #endif
-    QString strText = m_pBuffer->at(m_ptCursor.y())->getText();
-    int at = m_pBuffer->at(m_ptCursor.y())->pos(m_ptCursor.x());
+    TextLine * line = m_pBuffer->at(m_ptCursor.y());
+    QString strText = line->getText();
+    int at = line->pos(m_ptCursor.x());
     if (at == -1 || at >= strText.length()) {
         return false;
     }
+    int lineLength = strText.length();
 
     if (at > m_rcUrl.left() && at < m_rcUrl.right() && m_rcUrl.y() == m_ptCursor.y()) {
         rcUrl = m_rcUrl;
@@ -488,7 +502,20 @@ bool BBS::checkIP(QRect& rcUrl, QRect& rcOld)
         return true;
     }
 
-    QRegExp rx("(?:(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)\\.){3}(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?|\\*)");
+    // join the lines the address may have wrapped across
+    int offset = 0;
+    TextLine * prev = m_pBuffer->at(m_ptCursor.y() - 1);
+    if (prev != NULL && prev->getLength() >= m_pBuffer->columns()) {
+        QString prevText = prev->getText();
+        offset = prevText.length();
+        strText.prepend(prevText);
+        at += offset;
+    }
+    TextLine * next = m_pBuffer->at(m_ptCursor.y() + 1);
+    if (next != NULL && line->getLength() >= m_pBuffer->columns())
+        strText += next->getText();
+
+    QRegExp & rx = m_ipRe;
     int pos = 0;
     int ip_begin = 0;
     int ip_end = 0;
@@ -509,6 +536,9 @@ bool BBS::checkIP(QRect& rcUrl, QRect& rcOld)
     m_strIP = strText.mid(ip_begin, ip_end - ip_begin);//get the pure ip address
     if (m_strIP[ m_strIP.length()-1 ] == '*')
         m_strIP.replace(m_strIP.length() - 1 , 1, "1");
+    // the part on the cursor line
+    ip_begin = qMax(ip_begin - offset, 0);
+    ip_end = qMin(ip_end - offset, lineLength);
     rcUrl = QRect(ip_begin, m_ptCursor.y(), ip_end - ip_begin, 1);
 
     return true;
@@ -530,39 +560,46 @@ bool BBS::isPageComplete()
            && m_pBuffer->caret().x() == (m_pBuffer->columns() - 1);
 }
 
+// Compare the screen rows with what the analyses last saw.  Rows that
+// changed are recomputed, and so are urls that ran into them.
+void BBS::syncLines()
+{
+    int rows = m_pBuffer->line();
+    if (m_lineInfo.size() != rows || m_lineColumns != m_pBuffer->columns()) {
+        m_lineInfo = QVector<LineInfo>(rows);
+        m_lineColumns = m_pBuffer->columns();
+        m_generation++;
+    }
+    for (int i = 0; i < rows; i++) {
+        TextLine * line = m_pBuffer->screen(i);
+        LineInfo & info = m_lineInfo[i];
+        if (line != NULL && line == info.line && line->revision() == info.revision)
+            continue;
+        info.line = line;
+        info.revision = line != NULL ? line->revision() : 0;
+        info.unicolor = line != NULL && isUnicolor(line);
+        info.urlValid = false;
+        for (int j = 0; j < i; j++)
+            if (m_lineInfo[j].urlNext > i)
+                m_lineInfo[j].urlValid = false;
+        m_generation++;
+    }
+}
+
 void BBS::updateUrlList()
 {
+    syncLines();
     m_urlPosList.clear();
-    for (int i = 0; i < m_pBuffer->line(); i++) {
-        TextLine * lineBegin = m_pBuffer->screen(i);
-        if (lineBegin == NULL) {
-            break;
-        }
-        for (int j = 0; j < m_pBuffer->columns(); j++) {
-            int index = checkUrlBegin(lineBegin->getText(),j);
-            if (index != -1) {
-                int urlBegin = i*m_pBuffer->columns() + lineBegin->beginIndex(index);
-                int index2 = checkUrlEnd(lineBegin->getText(), index);
-                bool multiline = false;
-                if (index2 == -1) {
-                    while (m_pBuffer->screen(i+1) != NULL&&index2 == -1&&i < m_pBuffer->line()) {
-                        i++;
-                        TextLine * lineCurrent = m_pBuffer->screen(i);
-                        index2 = checkUrlEnd(lineCurrent->getText(), 0);
-                    }
-                    multiline = true;
-                }
-                if (index2 == -1) {
-                    index2 = m_pBuffer->screen(i)->getText().length() - 1;
-                }
-                int urlEnd = i*m_pBuffer->columns() + m_pBuffer->screen(i)->beginIndex(index2);
-                if (verifyUrl(urlBegin, urlEnd))
-                    m_urlPosList.append(qMakePair(urlBegin, urlEnd));
-                if (multiline)
-                    break;
-                j = index2;
-            }
+    int i = 0;
+    while (i < m_lineInfo.size()) {
+        LineInfo & info = m_lineInfo[i];
+        if (!info.urlValid) {
+            info.urls.clear();
+            info.urlNext = scanUrls(i, info.urls);
+            info.urlValid = true;
         }
+        m_urlPosList += info.urls;
+        i = info.urlNext;
     }
 //    if (!m_urlPosList.isEmpty()) {
 //        QPair<int, int> url;
@@ -572,6 +609,66 @@ void BBS::updateUrlList()
 //    }
 }
 
+// Find the urls that begin on row, return the first row not looked at.
+// One pass over the text: every run of characters that may appear in
+// an url is a candidate, a run reaching the right margin continues on
+// the following lines.
+int BBS::scanUrls(int row, QList< QPair<int,int> > & urls)
+{
+    int i = row;
+    int columns = m_pBuffer->columns();
+    TextLine * lineBegin = m_pBuffer->screen(i);
+    if (lineBegin == NULL) {
+        return m_pBuffer->line();
+    }
+    QString text = lineBegin->getText();
+    const QChar * str = text.unicode();
+    int len = text.length();
+    int pos = 0;
+    while (pos < len) {
+        while (pos < len && isIllChar(str[pos]))
+            pos++;
+        if (pos == len)
+            break;
+        int begin = pos;
+        bool dot = false;
+        while (pos < len && !isIllChar(str[pos])) {
+            if (str[pos] == '.')
+                dot = true;
+            pos++;
+        }
+        int urlBegin = i*columns + lineBegin->beginIndex(begin);
+
+        if (pos < len || lineBegin->getLength() < columns) {
+            // verifyUrl() wants at least one dot in the host
+            if (dot && verifyUrl(urlBegin, i*columns + lineBegin->beginIndex(pos - 1) + 1))
+                urls.append(qMakePair(urlBegin, i*columns + lineBegin->beginIndex(pos - 1) + 1));
+            continue;
+        }
+
+        // wrapped, take each following line up to its first
+        // character that ends an url
+        int index2 = -1;
+        TextLine * lineCurrent = lineBegin;
+        while (index2 == -1 && lineCurrent->getLength() >= columns
+                && m_pBuffer->screen(i+1) != NULL) {
+            i++;
+            lineCurrent = m_pBuffer->screen(i);
+            QString next = lineCurrent->getText();
+            for (index2 = 0; index2 < next.length() && !isIllChar(next.at(index2)); index2++) ;
+            if (index2 == next.length() && lineCurrent->getLength() >= columns)
+                index2 = -1;
+        }
+        if (index2 == -1)
+            index2 = lineCurrent->getText().length();
+        int urlEnd = i*columns + (index2 > 0 ? lineCurrent->beginIndex(index2 - 1) + 1 : 0);
+        if (verifyUrl(urlBegin, urlEnd))
+            urls.append(qMakePair(urlBegin, urlEnd));
+        break;
+    }
+    return i + 1;
+}
+
 //FIXME: The function use the assumption that the Url is latin only
 bool BBS::verifyUrl(int urlBegin, int urlEnd)
 {
@@ -589,15 +686,14 @@ bool BBS::verifyUrl(int urlBegin, int urlEnd)
     url = 0;
     host = 0;
     end = strText.length()-1;
-    QRegExp urlRe("^(mailto:|(https?|mms|rstp|ftp|gopher|telnet|ed2k|file)://)");
-    if ((begin = urlRe.indexIn(strText))!=-1) {
-        if (urlRe.capturedTexts().contains("mailto:")) {
-            if ((ata = strText.indexOf('@', begin + 1)) == -1)
+    if ((begin = m_schemeRe.indexIn(strText)) == 0) {
+        if (m_schemeRe.cap(1) == "mailto:") {
+            if ((ata = strText.indexOf('@', begin + 1)) != -1)
                 host = url + (ata - begin) + 1;
             else
                 return false;
         } else {
-            host = url+urlRe.matchedLength();
+            host = url+m_schemeRe.matchedLength();
         }
     } else {
         begin = url;
@@ -671,30 +767,5 @@ QString BBS::getText(int startpt, int endpt)
     return text;
 }
 
-int BBS::checkUrlBegin( const QString & lineText, int index)
-{
-    int i = 0;
-    QString urlText = lineText;
-    for (i = index; i < urlText.length() && isIllChar(urlText.at(i)); i++) ;
-    if (i < urlText.length()) {
-        return i;
-    }
-    return -1;
-}
-
-int BBS::checkUrlEnd( const QString & lineText, int index)
-{
-    int i = 0;
-    QString urlText = lineText;
-    if (urlText.isEmpty()) {
-        return 0;
-    }
-    for (i = index; i< urlText.length() && !isIllChar(urlText.at(i)); i++) ;
-    if (i < urlText.length()) {
-        return i;
-    }
-    return -1;
-}
-
 } // namespace QTerm
 
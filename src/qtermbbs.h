@@ -6,6 +6,8 @@
 #include <QtCore/QString>
 #include <QtCore/QPair>
 #include <QtCore/QList>
+#include <QtCore/QVector>
+#include <QtCore/QRegExp>
 
 class QRect;
 #ifdef SCRIPT_ENABLED
@@ -59,11 +61,24 @@ public:
     QString getText(int startpt, int endpt);
     void updateUrlList();
 
-    int checkUrlBegin(const QString & lineText, int index);
-    int checkUrlEnd(const QString & lineText, int index);
     bool verifyUrl(int urlBegin, int urlEnd);
 
 protected:
+    // what is known about one screen row, valid as long as the row
+    // holds the same line at the same revision
+    struct LineInfo {
+        LineInfo() : line(NULL), revision(0), unicolor(false),
+            urlValid(false), urlNext(0) {}
+        TextLine * line;
+        quint64 revision;
+        bool unicolor;
+        bool urlValid;
+        int urlNext; // first row after the urls found from this one
+        QList< QPair<int,int> > urls;
+    };
+    void syncLines();
+    int scanUrls(int row, QList< QPair<int,int> > & urls);
+
     bool isUnicolor(TextLine *);
     bool isIllChar(QChar);
     Buffer *m_pBuffer;
@@ -78,6 +93,23 @@ protected:
     int m_nScreenStart;
     QList< QPair<int,int> > m_urlPosList;
     QString m_url;
+
+    // compiled once, every screen update uses them
+    QRegExp m_schemeRe;
+    QRegExp m_emailRe;
+    QRegExp m_ipRe;
+
+    QVector<LineInfo> m_lineInfo;
+    int m_lineColumns;
+    int m_generation; // bumped whenever a screen row changes
+    int m_pageGeneration; // m_generation m_nPageState was computed at
+    // inputs of the last updateSelectRect()
+    TextLine * m_selLine;
+    quint64 m_selRevision;
+    QPoint m_selCursor;
+    int m_selPageState;
+    int m_selScreenStart;
+    int m_selLines;
 #ifdef SCRIPT_ENABLED
     QScriptEngine * m_scriptEngine;
     ScriptHelper * m_scriptHelper;
@@ -31,6 +31,7 @@ Buffer::Buffer(int line, int column, int limit)
     m_limit = limit;
 
     m_lines = 0;
+    m_dropped = 0;
 
     while (m_lineList.count() < m_lin)
         m_lineList.append(new TextLine(this));
@@ -109,6 +110,11 @@ int Buffer::line()
     return m_lin;
 }
 
+qint64 Buffer::dropped()
+{
+    return m_dropped;
+}
+
 TextLine * Buffer::at(int y)
 {
     return m_lineList.value(y , NULL);
@@ -459,6 +465,7 @@ void Buffer::addHistoryLine(int n)
     while (n) {
         if (m_lines == m_limit) {
             delete m_lineList.takeFirst();
+            m_dropped++;
             //m_ptSelStart.setY( m_ptSelStart.y()-1 );
             //m_ptSelEnd.setY( m_ptSelEnd.y()-1 );
             //if(m_ptSelStart.y()<0)
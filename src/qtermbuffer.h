@@ -34,6 +34,9 @@ public:
     int columns();
     int lines();
     int line();
+    // history lines discarded so far, dropped() + y numbers line y
+    // the same way for its whole lifetime
+    qint64 dropped();
 
     int  caretX();
     int  caretY();
@@ -110,6 +113,7 @@ protected:
 
     //
     int m_col, m_lin, m_lines, m_limit;
+    qint64 m_dropped;
 
     TextLine * m_pCurrentLine;
 
@@ -27,75 +27,100 @@ namespace QTerm
 {
 
 Convert::Convert()
+	: m_s2t(0x10000, 0), m_t2s(0x10000, 0)
 {
-	m_gbk = QTextCodec::codecForName("GBK");
-	m_big5 = QTextCodec::codecForName("Big5");
+	buildTables();
 }
 
 Convert::~Convert( ){}
 
-QString Convert::S2T(const QString & source)
+/* Both tables are generated once from GtoB/BtoG: every GB2312 character
+ * is decoded, mapped to Big5 and decoded again, and the other way round.
+ * Characters the tables do not cover are left untouched.
+ */
+void Convert::buildTables()
 {
-	QByteArray tmp = m_gbk->fromUnicode(source);
-	char * str = G2B(tmp.data(), tmp.size());
-	QString result = m_big5->toUnicode(str);
-	return result;
+	QTextCodec * gbk = QTextCodec::codecForName("GBK");
+	QTextCodec * big5 = QTextCodec::codecForName("Big5");
+	char from[3] = { 0, 0, 0 };
+	char to[3] = { 0, 0, 0 };
+	int c1, c2;
+
+	for( c1 = 0xa1; c1 <= 0xf7; c1++ )
+	{
+		if( c1 > 0xa9 && c1 < 0xb0 )
+			continue;
+		for( c2 = 0xa1; c2 <= 0xfe; c2++ )
+		{
+			from[0] = c1;
+			from[1] = c2;
+			g2b( c1, c2, to );
+			if( to[0] == GtoB_bad1 && to[1] == GtoB_bad2 )
+				continue;
+			QString s = gbk->toUnicode( from, 2 );
+			QString t = big5->toUnicode( to, 2 );
+			if( s.size() == 1 && t.size() == 1 && s[0] != t[0] && !t[0].isNull()
+			    && t[0] != QChar::ReplacementCharacter )
+				m_s2t[s[0].unicode()] = t[0].unicode();
+		}
+	}
+
+	for( c1 = 0xa1; c1 <= 0xf9; c1++ )
+	{
+		for( c2 = 0x40; c2 <= 0xfe; c2++ )
+		{
+			if( c2 > 0x7e && c2 < 0xa1 )
+				continue;
+			from[0] = c1;
+			from[1] = c2;
+			b2g( c1, c2, to );
+			if( to[0] == BtoG_bad1 && to[1] == BtoG_bad2 )
+				continue;
+			QString t = big5->toUnicode( from, 2 );
+			QString s = gbk->toUnicode( to, 2 );
+			if( s.size() == 1 && t.size() == 1 && s[0] != t[0] && !s[0].isNull()
+			    && s[0] != QChar::ReplacementCharacter )
+				m_t2s[t[0].unicode()] = s[0].unicode();
+		}
+	}
 }
 
-QString Convert::T2S(const QString & source)
+QString Convert::S2T(const QString & source) const
 {
-	QByteArray tmp = m_big5->fromUnicode(source);
-	char * str = B2G(tmp.data(), tmp.size());
-	QString result = m_gbk->toUnicode(str);
+	QString result = source;
+	S2T(result.data(), result.size());
 	return result;
 }
 
-char * Convert::G2B( const char * string, int length )
+QString Convert::T2S(const QString & source) const
 {
-	static char save='\0';
-	if( length ==0 )
-		return 0;
-	char * s = new char[length+2];	//because we may have the save char
-	int len = length;
-	const char * p = string;
-	int n=0;
+	QString result = source;
+	T2S(result.data(), result.size());
+	return result;
+}
 
-	if( save != '\0' )
+void Convert::S2T(QChar * data, int length) const
+{
+	const ushort * table = m_s2t.constData();
+	for( int i = 0; i < length; i++ )
 	{
-		g2b( save, *p, s );
-		n=2;
-		p++;
-		save='\0';
-		len++;
+		ushort c = table[data[i].unicode()];
+		if( c != 0 )
+			data[i] = QChar(c);
 	}
-	
-	while( p < string+length && *p != '\0' )
+}
+
+void Convert::T2S(QChar * data, int length) const
+{
+	const ushort * table = m_t2s.constData();
+	for( int i = 0; i < length; i++ )
 	{
-		if( *p & 0x80 )
-		{
-			// reach the end this is half of a word, save it
-			if( p == string+length-1 )
-			{
-				save = *p;
-				len--;
-				break;
-			}
-				
-			g2b( *p, *(p+1), s+n);
-			n+=2;
-			p+=2;
-		}
-		else
-		{
-			s[n]=*p;
-			p++;
-			n++;
-		}
+		ushort c = table[data[i].unicode()];
+		if( c != 0 )
+			data[i] = QChar(c);
 	}
-
-	s[len]='\0';
-	return s;
 }
+
 void  Convert::g2b( unsigned char c1, unsigned char c2, char * s)
 {
 	unsigned int i;
@@ -119,52 +144,6 @@ void  Convert::g2b( unsigned char c1, unsigned char c2, char * s)
 	s[0] = GtoB_bad1;
 	s[1] = GtoB_bad2;
 }
-char * Convert::B2G( const char * string, int length )
-{
-	static char save='\0';
-	if( length ==0 )
-		return 0;
-	char * s = new char[length+2];	//because we may have the save char
-	int len = length;
-	const char * p = string;
-	int n=0;
-	
-	if( save != '\0' )
-	{
-		b2g( save, *p, s );
-		n=2;
-		p++;
-		save='\0';
-		len++;
-	}
-	
-	while( p < string+length && *p != '\0' )
-	{
-		if( *p & 0x80 )
-		{
-			// reach the end this is half of a word, save it
-			if( p == string+length-1 )
-			{
-				save = *p;
-				len--;
-				break;
-			}
-				
-			b2g( *p, *(p+1), s+n);
-			p+=2;
-			n+=2;
-		}
-		else
-		{
-			s[n]=*p;
-			p++;
-			n++;
-		}
-	}
-
-	s[len]='\0';
-	return s;
-}
 void  Convert::b2g( unsigned char c1, unsigned char c2, char * s)
 {
 	unsigned int i;
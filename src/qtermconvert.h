@@ -1,6 +1,7 @@
 #ifndef QTERMCONVERT_H
 #define QTERMCONVERT_H
 #include <QtCore/QString>
+#include <QtCore/QVector>
 class QTextCodec;
 namespace QTerm
 {
@@ -10,19 +11,23 @@ public:
 	Convert();
 	~Convert();
 
-	QString S2T(const QString & source);
-	QString T2S(const QString & source);
+	QString S2T(const QString & source) const;
+	QString T2S(const QString & source) const;
+
+	// convert in place, no allocation
+	void S2T(QChar * data, int length) const;
+	void T2S(QChar * data, int length) const;
 
 private:
-	char * G2B( const char * string, int length );
-	char * B2G( const char * string, int length );
+	void buildTables();
 	void g2b( unsigned char c1, unsigned char c2, char * s);
 	void b2g( unsigned char c1, unsigned char c2, char * s);
 
 	static unsigned char GtoB[];
 	static unsigned char BtoG[];
-	QTextCodec * m_gbk;
-	QTextCodec * m_big5;
+	// BMP indexed, 0 where the character stays as it is
+	QVector<ushort> m_s2t;
+	QVector<ushort> m_t2s;
 };
 
 } // namespace QTErm
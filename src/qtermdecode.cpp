@@ -16,6 +16,10 @@ AUTHOR:        kingson fiasco
 #include <QtCore/QByteArray>
 //#include <QtDebug>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define MODE_MouseX11 0
 namespace QTerm
 {
@@ -189,10 +193,54 @@ void Decode::decode(const char *cstr, int length)
     m_pBuffer->endDecode();
 }
 
+// length of the run of printable ASCII (0x20-0x7f) at the start of str
+static int asciiRun(const char * str, int len)
+{
+    int n = 0;
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(0x1f);
+    while (n + 16 <= len) {
+        // signed compare, bytes with the high bit set are negative
+        __m128i v = _mm_loadu_si128((const __m128i *)(str + n));
+        int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(v, space));
+        if (mask != 0xffff) {
+            while (mask & 1) {
+                mask >>= 1;
+                n++;
+            }
+            return n;
+        }
+        n += 16;
+    }
+#endif
+    while (n < len && (uchar)str[n] >= 0x20 && (uchar)str[n] < 0x80)
+        n++;
+    return n;
+}
+
+// append len ASCII bytes to str as they are, no codec involved
+static void widenAscii(QString & str, const char * ascii, int len)
+{
+    int size = str.size();
+    str.resize(size + len);
+    ushort * out = (ushort *)str.data() + size;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(ascii + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+    for (; i < len; i++)
+        out[i] = (uchar)ascii[i];
+}
+
 // fill letters into char buffer
 void Decode::normalInput()
 {
-    if (m_state->remainingChars == 0 && inputData[dataIndex] < 0x20 && inputData[dataIndex] >= 0x00)   // not print char
+    if (m_state->remainingChars == 0 && (uchar)inputData[dataIndex] < 0x20)   // not print char
         return;
     bool fixAttr = false;
     if (m_state->remainingChars != 0 && m_attrHack) {
@@ -200,20 +248,35 @@ void Decode::normalInput()
         m_attrHack = false;
     }
     QString str;
+    const char * data = inputData + dataIndex;
+    int avail = inputLength - dataIndex;
     int n = 0;
-    while ((m_state->remainingChars != 0 || inputData[dataIndex + n] >= 0x20 || inputData[dataIndex + n] < 0x00)
-            && (dataIndex + n) < inputLength) {
-        str += m_decoder->toUnicode(inputData+dataIndex + n, 1, m_state);
-        n++;
-        if (m_state->remainingChars != 0 && (dataIndex + n + 1) < inputLength && inputData[dataIndex+n] == CHAR_ESC && inputData[dataIndex+n+1] == '[') {
+    // ASCII is copied a run at a time, the codec only sees the
+    // multibyte characters and whatever completes them
+    while (n < avail) {
+        if (m_state->remainingChars == 0) {
+            int run = asciiRun(data + n, avail - n);
+            if (run > 0) {
+                widenAscii(str, data + n, run);
+                n += run;
+                continue;
+            }
+            if ((uchar)data[n] < 0x20)
+                break;
+        }
+        int m = 1;
+        if (m_state->remainingChars == 0)
+            while (n + m < avail && (uchar)data[n + m] >= 0x80)
+                m++;
+        str += m_decoder->toUnicode(data + n, m, m_state);
+        n += m;
+        if (m_state->remainingChars != 0 && n + 1 < avail && data[n] == CHAR_ESC && data[n+1] == '[') {
             //qDebug("Decode::normalInput: esc sequence in the middle of a char");
             m_attrHack = true;
             break;
         }
     }
 
-    //QByteArray cstr(inputData + dataIndex, n);
-    //QString str = m_decoder->toUnicode(inputData+dataIndex, n, m_state);
     m_pBuffer->setBuffer(str, n);
     if (fixAttr == true) {
         //qDebug("Decode::normalInput: load attr");
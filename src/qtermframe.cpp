@@ -322,6 +322,7 @@ void Frame::saveAndDisconnect()
     }
 
     Global::instance()->saveSession(sites);
+    Global::instance()->flushAddressXml();
     saveSetting();
     // clear zmodem and pool if needed
     if (Global::instance()->m_pref.bClearPool) {
@@ -332,7 +333,7 @@ void Frame::saveAndDisconnect()
 }
 
 //create a new display window
-void Frame::newWindow(const Param&  param, const QString& uuid)
+void Frame::newWindow(const Param&  param, const QString& uuid, bool activate)
 {
     Window * window = new Window(this, param, uuid, mdiArea, 0);
     window->setWindowTitle(param.m_mapParam["name"].toString());
@@ -340,7 +341,8 @@ void Frame::newWindow(const Param&  param, const QString& uuid)
     window->setAttribute(Qt::WA_DeleteOnClose);
     window->showMaximized();
     //mdiArea->addSubWindow(window);
-    mdiArea->setActiveSubWindow(window);
+    if (activate)
+        mdiArea->setActiveSubWindow(window);
     connect(window, SIGNAL(destroyed(QObject*)),
             this, SLOT(windowClosed(QObject*)));
 }
@@ -1154,11 +1156,16 @@ void Frame::loadSession()
     QList<QVariant> sites = Global::instance()->loadSession();
     if (sites.empty()) {
         connectMenuActivated("");
-    } else {
-        for (int i = 0; i < sites.size(); i++) {
-            QString uuid = sites.at(i).toString();
-            connectMenuActivated(uuid);
-        }
+        return;
+    }
+    // read the address book once, every window connects as soon as it
+    // is created and only the last one is brought to front
+    QDomDocument doc = Global::instance()->addrXml();
+    for (int i = 0; i < sites.size(); i++) {
+        QString uuid = sites.at(i).toString();
+        Param param;
+        if (Global::instance()->loadAddress(doc, uuid, param))
+            newWindow(param, uuid, i == sites.size() - 1);
     }
 }
 
@@ -125,7 +125,7 @@ protected:
 	StatusBar *m_pStatusBar;
 
     //function
-    void newWindow(const Param& param, const QString& uuid="");
+    void newWindow(const Param& param, const QString& uuid="", bool activate = true);
     void closeEvent(QCloseEvent *);
     void keyPressEvent(QKeyEvent *);
     void mouseReleaseEvent(QMouseEvent *);
@@ -14,6 +14,7 @@
 #include "qtermconfig.h"
 #include "qtermparam.h"
 #include "qtermconvert.h"
+#include "qtermsiteindex.h"
 #ifdef KWALLET_ENABLED
 #include "wallet.h"
 #endif // KWALLET_ENABLED
@@ -27,6 +28,11 @@
 #include <QtCore/QLibraryInfo>
 #include <QtCore/QUuid>
 #include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <QtCore/QDebug>
+#if QT_VERSION >= 0x050000
+#include <QtCore/QSaveFile>
+#endif
 #include <QDesktopServices>
 #include <QApplication>
 #include <QFileDialog>
@@ -39,6 +45,8 @@
 #ifndef MAX_PATH
 #define MAX_PATH 128
 #endif
+#else
+#include <stdio.h>
 #endif
 
 namespace QTerm
@@ -63,6 +71,7 @@ Global * Global::instance()
 
 Global::Global()
         : m_fileCfg("./qterm.cfg"), m_addrCfg("./address.cfg"), m_addrXml("./address.xml"),
+        m_addrDoc(), m_addrLoaded(false), m_siteIndex(), m_siteSearch(NULL),
         m_pathLib("./"), m_pathCfg("./"), 
         m_windowState(), m_status(INIT_OK), m_style(), 
         m_fullScreen(false), m_language(Global::English)
@@ -75,6 +84,10 @@ Global::Global()
         m_wallet = NULL;
     }
 #endif // KWALLET_ENABLED
+    m_addrTimer = new QTimer(this);
+    m_addrTimer->setSingleShot(true);
+    m_addrTimer->setInterval(1000);
+    connect(m_addrTimer, SIGNAL(timeout()), this, SLOT(writeAddressXml()));
     if (!iniWorkingDir(qApp->arguments()[0])) {
         m_status = INIT_ERROR;
         return;
@@ -105,13 +118,54 @@ Config * Global::fileCfg()
 
 QDomDocument Global::addrXml()
 {
-    QDomDocument doc;
-    QFile file(m_addrXml);
-    if (file.open(QIODevice::ReadOnly)) {
-        doc.setContent(&file);
-        file.close();
+    if (!m_addrLoaded) {
+        QFile file(m_addrXml);
+        if (file.open(QIODevice::ReadOnly)) {
+            m_addrDoc.setContent(&file);
+            file.close();
+        }
+        m_addrLoaded = true;
+        indexAddressXml();
+    }
+    return m_addrDoc;
+}
+
+void Global::indexAddressXml()
+{
+    m_siteIndex.clear();
+    QDomNodeList nodeList = m_addrDoc.elementsByTagName("site");
+    for (int i=0; i<nodeList.count(); i++) {
+        QDomElement node = nodeList.at(i).toElement();
+        m_siteIndex.insert(node.attribute("uuid"), node);
     }
-    return doc;
+}
+
+SiteIndex * Global::siteIndex()
+{
+    if (m_siteSearch == NULL) {
+        m_siteSearch = new SiteIndex;
+        m_siteSearch->build(addrXml());
+    }
+    return m_siteSearch;
+}
+
+QDomElement Global::findSite(QDomDocument doc, const QString & uuid)
+{
+    // every change to the cached document goes through here, so a miss
+    // in the index is final, a hit is checked in case it was detached
+    if (doc == m_addrDoc) {
+        QDomElement node = m_siteIndex.value(uuid);
+        if (!node.isNull() && !node.parentNode().isNull())
+            return node;
+        return QDomElement();
+    }
+    QDomNodeList nodeList = doc.elementsByTagName("site");
+    for (int i=0; i<nodeList.count(); i++) {
+        QDomElement node = nodeList.at(i).toElement();
+        if (uuid == node.attribute("uuid"))
+            return node;
+    }
+    return QDomElement();
 }
 
 const QString & Global::pathLib()
@@ -154,21 +208,18 @@ bool Global::loadAddress(QDomDocument doc, QString uuid, Param& param)
 {
     if (uuid.isEmpty())
         uuid = QUuid().toString();
-    QDomNodeList nodeList = doc.elementsByTagName("site");
-    for (int i=0; i<nodeList.count(); i++) {
-        QDomElement node = nodeList.at(i).toElement();
-        if (uuid == node.attribute("uuid"))
-            foreach (QString key, param.m_mapParam.keys())  {
-                #ifdef KWALLET_ENABLED
-                if (key == "password" && m_wallet != NULL) {
-                    m_wallet->open();
-                    param.m_mapParam["password"] = m_wallet->readPassword(
-                        node.attribute("name"), node.attribute("user"));
-                } else
-                #endif // KWALLET_ENABLED
-                param.m_mapParam[key] = node.attribute(key);
-            }
-    }
+    QDomElement node = findSite(doc, uuid);
+    if (!node.isNull())
+        foreach (QString key, param.m_mapParam.keys())  {
+            #ifdef KWALLET_ENABLED
+            if (key == "password" && m_wallet != NULL) {
+                m_wallet->open();
+                param.m_mapParam["password"] = m_wallet->readPassword(
+                    node.attribute("name"), node.attribute("user"));
+            } else
+            #endif // KWALLET_ENABLED
+            param.m_mapParam[key] = node.attribute(key);
+        }
     return true;
 }
 
@@ -205,61 +256,87 @@ bool Global::loadAddress(Config& addrCfg, int n, Param& param)
 
 void Global::saveAddress(QDomDocument doc, QString uuid, const Param& param)
 {
-    bool result = false;
     // find and replace existing site
-    QDomNodeList nodeList = doc.elementsByTagName("site");
-    for (int i=0; i<nodeList.count(); i++) {
-        QDomElement node = nodeList.at(i).toElement();
-        if (uuid == node.attribute("uuid")) {
+    QDomElement node = findSite(doc, uuid);
+    if (!node.isNull()) {
 #ifdef KWALLET_ENABLED
-            if (m_wallet != NULL) {
-                m_wallet->open();
-                m_wallet->writePassword(param.m_mapParam["name"].toString(), param.m_mapParam["user"].toString(), param.m_mapParam["password"].toString());
-            }
+        if (m_wallet != NULL) {
+            m_wallet->open();
+            m_wallet->writePassword(param.m_mapParam["name"].toString(), param.m_mapParam["user"].toString(), param.m_mapParam["password"].toString());
+        }
 #endif // KWALLET_ENABLED
-            foreach (QString key, param.m_mapParam.keys()) {
+        foreach (QString key, param.m_mapParam.keys()) {
 #ifdef KWALLET_ENABLED
-                if (key == "password")
-                    node.setAttribute(key, "");
-                else
+            if (key == "password")
+                node.setAttribute(key, "");
+            else
 #endif // KWALLET_ENABLED
-                node.setAttribute(key,
-                    param.m_mapParam[key].toString());
-}
-            result = true;
-            break;
+            node.setAttribute(key,
+                param.m_mapParam[key].toString());
         }
+        if (doc == m_addrDoc && m_siteSearch != NULL)
+            m_siteSearch->setSite(node);
+        return;
     }
     // create new site otherwise
-    if (!result) {
-        QDomElement site = doc.createElement("site");
-        site.setAttribute("uuid", uuid);
-        foreach (QString key, param.m_mapParam.keys()) 
-                site.setAttribute(key, 
-                    param.m_mapParam[key].toString());
-        doc.documentElement().appendChild(site);
-        result = true;
+    QDomElement site = doc.createElement("site");
+    site.setAttribute("uuid", uuid);
+    foreach (QString key, param.m_mapParam.keys()) 
+            site.setAttribute(key, 
+                param.m_mapParam[key].toString());
+    doc.documentElement().appendChild(site);
+    if (doc == m_addrDoc) {
+        m_siteIndex.insert(uuid, site);
+        if (m_siteSearch != NULL)
+            m_siteSearch->setSite(site);
     }
-
-    if (!result) return;
-
 }
 
 void Global::removeAddress(QDomDocument doc, QString uuid)
 {
-    QDomNodeList nodeList;
     // remove the actual site
-    nodeList = doc.elementsByTagName("site");
-    for (int i=0; i<nodeList.count(); i++) {
-        QDomElement node = nodeList.at(i).toElement();
-        if (uuid == node.attribute("uuid")) {
-            doc.removeChild(node);
-        }
+    QDomElement node = findSite(doc, uuid);
+    if (!node.isNull())
+        node.parentNode().removeChild(node);
+    if (doc == m_addrDoc) {
+        m_siteIndex.remove(uuid);
+        if (m_siteSearch != NULL)
+            m_siteSearch->removeSite(uuid);
     }
 }
 
+// put src in the place of dst in one step, dst is never missing meanwhile
+static bool replaceFile(const QString & src, const QString & dst)
+{
+#if defined(_OS_WIN32_) || defined(Q_OS_WIN32)
+    return MoveFileExW((LPCWSTR) QDir::toNativeSeparators(src).utf16(),
+                       (LPCWSTR) QDir::toNativeSeparators(dst).utf16(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return ::rename(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0;
+#endif
+}
+
+// a write of the address book cut short before address.xml.new took the
+// place of address.xml; complete, it is the newer one
+void Global::recoverAddressXml()
+{
+    QString tmpName = m_addrXml + ".new";
+    QFile file(tmpName);
+    if (!file.exists())
+        return;
+    QDomDocument doc;
+    bool complete = file.open(QIODevice::ReadOnly) && doc.setContent(&file);
+    file.close();
+    if (complete && replaceFile(tmpName, m_addrXml))
+        qDebug() << "Recovered" << m_addrXml << "from" << tmpName;
+    else
+        QFile::remove(tmpName);
+}
+
 bool Global::convertAddressBook2XML()
 {
+    recoverAddressXml();
     QDir dir;
     if (dir.exists(m_addrXml))// do nothing if address.xml existed
         return true;
@@ -312,17 +389,58 @@ bool Global::convertAddressBook2XML()
         addresses.appendChild(site);
     }
     saveAddressXml(doc);
+    flushAddressXml();
     return true;
 }
 
 void Global::saveAddressXml(const QDomDocument& doc)
 {
-    QFile ofile(m_addrXml);
-    if (ofile.open(QIODevice::WriteOnly)) {
-        QTextStream out(&ofile);
-        out.setCodec("UTF-8");
-        out << doc.toString();
-        ofile.close();
+    // a document edited elsewhere, e.g. by the address book dialog,
+    // becomes the cached one, copied so later edits there do not leak in
+    if (doc != m_addrDoc) {
+        m_addrDoc = doc.cloneNode(true).toDocument();
+        indexAddressXml();
+        if (m_siteSearch != NULL)
+            m_siteSearch->build(m_addrDoc);
+    }
+    m_addrLoaded = true;
+    // a burst of edits is written once
+    m_addrTimer->start();
+    emit addressBookChanged();
+}
+
+void Global::flushAddressXml()
+{
+    if (m_addrTimer->isActive())
+        writeAddressXml();
+}
+
+// replace the file as a whole, a crash never leaves half of it
+void Global::writeAddressXml()
+{
+    m_addrTimer->stop();
+    QByteArray data = m_addrDoc.toByteArray();
+    bool written;
+#if QT_VERSION >= 0x050000
+    QSaveFile ofile(m_addrXml);
+    written = ofile.open(QIODevice::WriteOnly) && ofile.write(data) == data.size()
+              && ofile.commit();
+#else
+    QString tmpName = m_addrXml + ".new";
+    QFile ofile(tmpName);
+    written = ofile.open(QIODevice::WriteOnly) && ofile.write(data) == data.size()
+              && ofile.flush();
+    ofile.close();
+    if (!written)
+        QFile::remove(tmpName);
+    // left behind if this fails, recoverAddressXml() takes it up next time
+    else if (!replaceFile(tmpName, m_addrXml))
+        written = false;
+#endif
+    if (!written) {
+        qDebug() << "Failed to write" << m_addrXml << ofile.errorString();
+        QMessageBox::warning(0, "QTerm", tr("Failed to save the address book to %1: %2")
+                             .arg(m_addrXml).arg(ofile.errorString()));
     }
 }
 
@@ -346,6 +464,10 @@ void Global::loadPrefence()
     m_pref.strPlayer = m_config->getItemValue("preference", "externalplayer").toString();
     m_pref.strImageViewer = m_config->getItemValue("preference", "image").toString();
     m_pref.bClearPool = m_config->getItemValue("preference", "clearpool").toBool();
+    m_pref.bSharedScript = m_config->getItemValue("preference", "sharedscript").toBool();
+    // configurations older than the watchdog lack the key, 0 turns it off
+    QString strBudget = m_config->getItemValue("preference", "scriptbudget").toString();
+    m_pref.nScriptBudget = strBudget.isEmpty() ? 2000 : strBudget.toInt();
 
     QString strTmp = m_config->getItemValue("preference", "pool").toString();
     m_pref.strPoolPath = strTmp.isEmpty() ? Global::instance()->pathCfg() + "pool/" : strTmp;
@@ -807,6 +929,7 @@ QList<QVariant> Global::loadSession()
 
 void Global::cleanup()
 {
+    flushAddressXml();
 #ifdef KWALLET_ENABLED
     if (m_wallet != NULL)
         m_wallet->close();
@@ -862,6 +985,20 @@ QString Global::convert(const QString & source, Global::Conversion flag)
     return source;
 }
 
+void Global::convert(QChar * data, int length, Global::Conversion flag)
+{
+    switch (flag) {
+    case Simplified_To_Traditional:
+        m_converter->S2T(data, length);
+        break;
+    case Traditional_To_Simplified:
+        m_converter->T2S(data, length);
+        break;
+    default:
+        break;
+    }
+}
+
 } // namespace QTerm
 
 #include <moc_qtermglobal.cpp>
@@ -18,13 +18,18 @@
 #include <QtCore/QMutex>
 #include <QtCore/QString>
 #include <QtCore/QMap>
+#include <QtCore/QHash>
 #include <QtCore/QObject>
 #include <QtXml/QDomDocument>
+#include <QtXml/QDomElement>
+
+class QTimer;
 
 namespace QTerm
 {
 class Config;
 class Convert;
+class SiteIndex;
 #ifdef KWALLET_ENABLED
 class Wallet;
 #endif //KWALLET_ENABLED
@@ -73,12 +78,16 @@ public:
         bool bAA;
         bool bTray;
         bool bClearPool;
+        bool bSharedScript;
+        int nScriptBudget;
         QString strZmPath;
         QString strPoolPath;
         QString strImageViewer;
     };
     static Global * instance();
     Config * fileCfg();
+    // the address book is parsed once and shared, the document returned
+    // is the cached one, clone it before editing without saving
     QDomDocument addrXml();
     const QString & pathLib();
     const QString & pathPic();
@@ -90,6 +99,10 @@ public:
     void saveAddress(QDomDocument doc, QString uuid, const Param & param);
     void removeAddress(QDomDocument doc, QString uuid);
     void saveAddressXml(const QDomDocument& doc);
+    void flushAddressXml();
+    QDomElement findSite(QDomDocument doc, const QString & uuid);
+    // text search over the cached address book
+    SiteIndex * siteIndex();
     bool convertAddressBook2XML();
     // deprecated cfg address book, here only for conversion reason
     bool loadAddress(Config &addrCfg, int n, Param & param);
@@ -132,6 +145,13 @@ public:
     void cleanup();
     void openUrl(const QString & url);
     QString convert(const QString & source, Conversion flag);
+    void convert(QChar * data, int length, Conversion flag);
+
+signals:
+    void addressBookChanged();
+
+private slots:
+    void writeAddressXml();
 
 private:
     Global();
@@ -141,9 +161,17 @@ private:
     bool isPathExist(const QString & path);
     bool createLocalFile(const QString & dst, const QString & src);
     void closeNotification(uint id);
+    void indexAddressXml();
+    void recoverAddressXml();
     QString m_fileCfg;
     QString m_addrCfg;
     QString m_addrXml;
+    // cached address book, its sites by uuid and the pending write
+    QDomDocument m_addrDoc;
+    bool m_addrLoaded;
+    QHash<QString, QDomElement> m_siteIndex;
+    QTimer * m_addrTimer;
+    SiteIndex * m_siteSearch;
     QString m_pathLib;
     QString m_pathPic;
     QString m_pathCfg;
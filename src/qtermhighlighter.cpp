@@ -0,0 +1,173 @@
+#include "qtermhighlighter.h"
+#include "qtermtextline.h"
+
+namespace QTerm
+{
+
+// lines kept matched, the cache is dropped when it grows past this
+static const int CacheSize = 1024;
+
+static void addSpan(QVector<Highlighter::Span> & spans, TextLine * line,
+                    int length, int pos, int len, short attr)
+{
+    Highlighter::Span span;
+    span.first = line->beginIndex(pos);
+    span.last = pos + len < length ? line->beginIndex(pos + len) - 1
+                                   : line->getLength() - 1;
+    span.attr = attr;
+    spans << span;
+}
+
+Highlighter::Highlighter()
+    : m_keywords(), m_regexps(), m_nodes(), m_dirty(false), m_cache()
+{
+}
+
+Highlighter::~Highlighter()
+{
+}
+
+bool Highlighter::addRule(const QString & pattern, short attr, bool regex)
+{
+    if (pattern.isEmpty())
+        return false;
+    if (regex) {
+        QRegExp re(pattern, Qt::CaseInsensitive);
+        if (!re.isValid())
+            return false;
+        foreach (const Regexp & r, m_regexps)
+            if (r.re == re && r.attr == attr)
+                return true;
+        Regexp r;
+        r.re = re;
+        r.attr = attr;
+        m_regexps << r;
+    } else {
+        QString text(pattern);
+        for (int i = 0; i < text.length(); i++)
+            text[i] = text.at(i).toCaseFolded();
+        foreach (const Keyword & k, m_keywords)
+            if (k.text == text && k.attr == attr)
+                return true;
+        Keyword k;
+        k.text = text;
+        k.attr = attr;
+        m_keywords << k;
+    }
+    m_dirty = true;
+    return true;
+}
+
+void Highlighter::clear()
+{
+    m_keywords.clear();
+    m_regexps.clear();
+    m_nodes.clear();
+    m_cache.clear();
+    m_dirty = false;
+}
+
+// build the keyword automaton, node 0 is the root
+void Highlighter::build()
+{
+    m_nodes.clear();
+    m_nodes.append(Node());
+    for (int k = 0; k < m_keywords.size(); k++) {
+        const QString & text = m_keywords.at(k).text;
+        int n = 0;
+        for (int i = 0; i < text.length(); i++) {
+            ushort c = text.at(i).unicode();
+            int child = m_nodes.at(n).next.value(c, -1);
+            if (child == -1) {
+                child = m_nodes.size();
+                m_nodes.append(Node());
+                m_nodes[n].next.insert(c, child);
+            }
+            n = child;
+        }
+        if (m_nodes.at(n).keyword == -1)
+            m_nodes[n].keyword = k;
+    }
+
+    // breadth first, so the fail target of a node is always done before it
+    QList<int> queue;
+    queue << 0;
+    while (!queue.isEmpty()) {
+        int u = queue.takeFirst();
+        QHash<ushort, int>::const_iterator it;
+        for (it = m_nodes.at(u).next.constBegin(); it != m_nodes.at(u).next.constEnd(); ++it) {
+            int v = it.value();
+            int fail = 0;
+            if (u != 0) {
+                int f = m_nodes.at(u).fail;
+                while (f != 0 && !m_nodes.at(f).next.contains(it.key()))
+                    f = m_nodes.at(f).fail;
+                fail = m_nodes.at(f).next.value(it.key(), 0);
+            }
+            m_nodes[v].fail = fail;
+            m_nodes[v].output = m_nodes.at(fail).keyword != -1 ? fail : m_nodes.at(fail).output;
+            queue << v;
+        }
+    }
+}
+
+QVector<Highlighter::Span> Highlighter::spans(TextLine * line)
+{
+    if (line == NULL || isEmpty())
+        return QVector<Span>();
+    if (m_dirty) {
+        build();
+        m_cache.clear();
+        m_dirty = false;
+    }
+    QHash<TextLine *, Entry>::const_iterator it = m_cache.constFind(line);
+    if (it != m_cache.constEnd() && it.value().revision == line->revision())
+        return it.value().spans;
+
+    if (m_cache.size() >= CacheSize)
+        m_cache.clear();
+    Entry entry;
+    entry.revision = line->revision();
+    entry.spans = match(line);
+    m_cache.insert(line, entry);
+    return entry.spans;
+}
+
+QVector<Highlighter::Span> Highlighter::match(TextLine * line)
+{
+    QVector<Span> spans;
+    QString text = line->getText();
+    const QChar * p = text.unicode();
+
+    if (!m_keywords.isEmpty()) {
+        int n = 0;
+        for (int i = 0; i < text.length(); i++) {
+            ushort c = p[i].toCaseFolded().unicode();
+            while (n != 0 && !m_nodes.at(n).next.contains(c))
+                n = m_nodes.at(n).fail;
+            n = m_nodes.at(n).next.value(c, 0);
+            int o = m_nodes.at(n).keyword != -1 ? n : m_nodes.at(n).output;
+            for (; o != -1; o = m_nodes.at(o).output) {
+                const Keyword & k = m_keywords.at(m_nodes.at(o).keyword);
+                addSpan(spans, line, text.length(), i + 1 - k.text.length(), k.text.length(), k.attr);
+            }
+        }
+    }
+
+    foreach (const Regexp & r, m_regexps) {
+        QRegExp re(r.re);
+        int pos = 0;
+        while (pos < text.length() && (pos = re.indexIn(text, pos)) != -1) {
+            int len = re.matchedLength();
+            if (len <= 0) {
+                pos++;
+                continue;
+            }
+            addSpan(spans, line, text.length(), pos, len, r.attr);
+            pos += len;
+        }
+    }
+    return spans;
+}
+
+} // namespace QTerm
@@ -0,0 +1,77 @@
+#ifndef QTERMHIGHLIGHTER_H
+#define QTERMHIGHLIGHTER_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QRegExp>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+namespace QTerm
+{
+class TextLine;
+
+/*
+ * Keyword highlighting drawn over the text by Screen::drawLine, the
+ * attributes stored in TextLine are never touched.
+ *
+ * Keywords are compiled into one Aho-Corasick automaton so a line is
+ * scanned once however many there are; regular expressions are run one
+ * after another.  Both ignore case.  A line is only matched again when
+ * its revision changes.
+ */
+class Highlighter
+{
+public:
+    struct Span {
+        int first, last;    // columns
+        short attr;
+    };
+
+    Highlighter();
+    ~Highlighter();
+
+    // returns false if the regular expression is invalid, adding the
+    // same rule twice is harmless
+    bool addRule(const QString & pattern, short attr, bool regex = false);
+    void clear();
+    bool isEmpty() const {
+        return m_keywords.isEmpty() && m_regexps.isEmpty();
+    }
+
+    QVector<Span> spans(TextLine * line);
+
+private:
+    struct Keyword {
+        QString text;
+        short attr;
+    };
+    struct Regexp {
+        QRegExp re;
+        short attr;
+    };
+    struct Node {
+        Node() : fail(0), keyword(-1), output(-1) {}
+        QHash<ushort, int> next;
+        int fail;
+        int keyword;    // longest keyword ending here, -1 if none
+        int output;     // next node on the fail chain with a keyword
+    };
+    struct Entry {
+        quint64 revision;
+        QVector<Span> spans;
+    };
+
+    void build();
+    QVector<Span> match(TextLine * line);
+
+    QList<Keyword> m_keywords;
+    QList<Regexp> m_regexps;
+    QVector<Node> m_nodes;
+    bool m_dirty;
+    QHash<TextLine *, Entry> m_cache;
+};
+
+} // namespace QTerm
+
+#endif // QTERMHIGHLIGHTER_H
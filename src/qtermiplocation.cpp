@@ -10,7 +10,9 @@
 #include <QDir>
 #include <QStringList>
 #include <QTextCodec>
+#include <QMutexLocker>
 #include <ctype.h>
+#include <string.h>
 
 #ifdef Q_OS_WIN32
 #include <winsock2.h>
@@ -22,178 +24,156 @@
 namespace QTerm
 {
 
-IPLocation::IPLocation(QString & pathLib)
+IPLocation * IPLocation::m_Instance = 0;
+
+IPLocation * IPLocation::instance()
 {
-    f = new _ip_finder;
-    f->ipfp = NULL;
+    static QMutex mutex;
+    if (!m_Instance) {
+        mutex.lock();
+
+        if (!m_Instance)
+            m_Instance = new IPLocation;
+
+        mutex.unlock();
+    }
+
+    return m_Instance;
+}
 
-    fileExist = true;
+IPLocation::IPLocation()
+    : m_data(NULL), m_size(0), m_cache(1024)
+{
+    m_codec = QTextCodec::codecForName("GB18030");
     QString pathCfg = Global::instance()->pathCfg();
 
     //case-insensitive match
     QDir dir(pathCfg);
     QStringList files = dir.entryList(QStringList("[Qq][Qq][Ww][Rr][Yy].[Dd][Aa][Tt]"), QDir::Files);
-    if (!files.isEmpty()) {
-        if ((f->ipfp = fopen((pathCfg + (files.at(0))).toLocal8Bit(), "r")) == NULL) {
-            qDebug("can't open ipfile !");
-            fileExist = false;
-        }
-    } else
-        fileExist =  false;
-    m_codec = QTextCodec::codecForName("GB18030");
+    if (files.isEmpty())
+        return;
+    m_file.setFileName(pathCfg + files.at(0));
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < 8 || m_file.size() > 0xffffffffLL
+            || (m_data = m_file.map(0, m_file.size())) == NULL) {
+        qDebug("can't open ipfile !");
+        m_file.close();
+        return;
+    }
+    m_size = m_file.size();
+
+    quint32 first = read4(0);
+    quint32 last = read4(4);
+    if (first > last || last > m_size - 7) {
+        qDebug("invalid ipfile !");
+        return;
+    }
+    int count = (last - first) / 7 + 1;
+    m_startIp.resize(count);
+    m_endOffset.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_startIp[i] = read4(first + i * 7);
+        m_endOffset[i] = read3(first + i * 7 + 4);
+    }
 }
 
 IPLocation::~IPLocation()
 {
-    if (f->ipfp != NULL)
-        fclose(f->ipfp);
 }
 
 bool IPLocation::haveFile()
 {
-    return fileExist;
+    return !m_startIp.isEmpty();
 }
 
-uint32 IPLocation::byteArrayToInt(char *ip, int count)
+// little endian integers, reads past the end give 0
+quint32 IPLocation::read3(quint32 offset)
 {
-    uint32 tmp, ret = 0L;
-    if (count < 1 || count > 4) {
-        qDebug("error byteArrayToInt!");
+    if (m_size < 3 || offset > m_size - 3)
         return 0;
-    }
-    for (int i = 0; i < count; i++) {
-        tmp = ((uint32)ip[ i ]) & 0x000000FF;
-        ret |= (tmp << (8 * i));
-    }
-    return ret;
-}// _byte_array_to_int
-
-
-void IPLocation::readFrom(FILE *fp, uint32 offset, char *buf, int len)
-{
-    if (fseek(fp, (long)offset, SEEK_SET) == -1) {
-        qDebug(" readFrom error 1 ");
-        memset(buf, 0, len);
-        return;
-    }
-    if (fread(buf, sizeof(char), len, fp) == 0) {
-        qDebug(" readFrom error 2 ");
-        memset(buf, 0, len);
-        return;
-    }
-    return;
+    const uchar * p = m_data + offset;
+    return p[0] | (p[1] << 8) | (p[2] << 16);
 }
 
-int IPLocation::readLineFrom(FILE *fp, uint32 offset, QString& ret_str)
+quint32 IPLocation::read4(quint32 offset)
 {
-    char str[512];
-    if (fseek(fp, (long)offset, SEEK_SET) == -1) {
-        qDebug(" readLineFrom error 1 ");
-        ret_str = QString();
-        return -1;
-    }
-    if (fgets((char *) str, 512, fp) == NULL) {
-        qDebug(" readLineFrom error 2 ");
-        ret_str = QString();
-        return -1;
-    }
-    ret_str = m_codec->toUnicode(str);
-    return strlen(str);
+    if (m_size < 4 || offset > m_size - 4)
+        return 0;
+    const uchar * p = m_data + offset;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32)p[3] << 24);
 }
 
-uint32 IPLocation::getString(FILE *fp, uint32 offset, uint32 lastoffset, QString& ret, unsigned int flag)
+int IPLocation::rawLength(quint32 offset)
 {
-    char *buf;
-    unsigned int fg;
-    int len;
-    if (fp == NULL) return 0;
-    buf = (char *) calloc(3, sizeof(char));
-    readFrom(fp, offset, buf , 1);
-    if (buf[0] == 0x01 || buf[0] == 0x02) {
-        fg = buf[0];
-        readFrom(fp, offset + 1, buf, 3);
-        return getString(fp, byteArrayToInt(buf, 3), offset, ret, fg);
-    } else {
-        len = readLineFrom(fp, offset, ret);
-    }
-    switch (flag) {
-    case 0x01:  return 0;
-    case 0x02:  return lastoffset + 4;
-    default:   return offset + len + 1;
-    }// switch
+    if (offset >= m_size)
+        return 0;
+    const uchar * end = (const uchar *)memchr(m_data + offset, 0, m_size - offset);
+    return end == NULL ? m_size - offset : end - (m_data + offset);
 }
 
-
-void IPLocation::getCountryCity(FILE *fp, uint32 offset, QString& country, QString& city)
+// a string, or a pointer to one if it starts with 1 or 2
+QString IPLocation::readString(quint32 offset)
 {
-    uint32 next_offset;
-    if (fp == NULL) return ;
-    next_offset = getString(fp, offset, 0L, country, 0);
-    if (next_offset == 0) city = "";
-    else getString(fp, next_offset, 0L, city, 0);
-    return;
+    if (offset < m_size && (m_data[offset] == 0x01 || m_data[offset] == 0x02))
+        offset = read3(offset + 1);
+    return m_codec->toUnicode((const char *)m_data + offset, rawLength(offset));
 }
 
-void IPLocation::setIpRange(int rec_no, _ip_finder *f)
+// the country may be redirected together with the city (1) or alone (2)
+void IPLocation::readRecord(quint32 offset, QString& country, QString& city)
 {
-    char *buf;
-    uint32 offset;
-    if (f == NULL) return;
-    buf = (char *)calloc(7, sizeof(char));
-    offset = f->offset_first_start_ip + rec_no * 7 ;
-
-    readFrom(f->ipfp, offset, buf, 7);
-    f->cur_start_ip  = byteArrayToInt(buf, 4);
-    f->offset_cur_end_ip = byteArrayToInt(buf + 4, 3);
-
-    readFrom(f->ipfp, f->offset_cur_end_ip, buf, 4);
-    f->cur_end_ip = byteArrayToInt(buf, 4);
-
-}// _set_ip_range
+    if (offset < m_size && m_data[offset] == 0x01)
+        offset = read3(offset + 1);
+    quint32 cityOffset;
+    if (offset < m_size && m_data[offset] == 0x02) {
+        country = readString(offset);
+        cityOffset = offset + 4;
+    } else {
+        country = readString(offset);
+        cityOffset = offset + rawLength(offset) + 1;
+    }
+    city = readString(cityOffset);
+}
 
 bool IPLocation::getLocation(QString& url, QString& country, QString& city)
 {
-    int rec, record_count, B, E;
-    char *buf;
-    uint32 ip;
+    quint32 ip;
 #ifdef  Q_OS_WIN32
-    uint32 ipValue = inet_addr((const char*)url.toLatin1());
+    quint32 ipValue = inet_addr((const char*)url.toLatin1());
 #else
     in_addr_t ipValue = inet_addr((const char*)url.toLatin1());
 #endif
-    if (ipValue == -1)
+    if (ipValue == INADDR_NONE)
         return false;
     else
         ip = ntohl(ipValue);
 
-    buf = (char *)calloc(4, sizeof(char));
-    memset(buf , 0 , 4);
-    readFrom(f->ipfp, 0L, (char *)buf, 4);
-    f->offset_first_start_ip = byteArrayToInt((char *)buf, 4);
-    readFrom(f->ipfp, 4L, (char *)buf, 4);
-    f->offset_last_start_ip  = byteArrayToInt((char *)buf, 4);
-
-    record_count = (f->offset_last_start_ip - f->offset_first_start_ip) / 7;
-    if (record_count <= 1) return false;
-
-    // search for right range
-    B = 0;  E = record_count;
-    while (B < E - 1) {
-        rec = (B + E) / 2;
-        setIpRange(rec, f) ;
-        if (ip == f->cur_start_ip) {
-            B = rec; break;
-        }
-        if (ip > f->cur_start_ip) B = rec; else E = rec;
-    }
-    setIpRange(B, f);
+    QMutexLocker locker(&m_mutex);
+    if (m_startIp.size() <= 1)
+        return false;
 
-    if (f->cur_start_ip <= ip && ip <= f->cur_end_ip) {
-        getCountryCity(f->ipfp, f->offset_cur_end_ip + 4, country, city);
+    // the last range starting at or below ip, without branches to mispredict
+    const quint32 * base = m_startIp.constData();
+    int n = m_startIp.size();
+    while (n > 1) {
+        int half = n / 2;
+        base = (base[half] <= ip) ? base + half : base;
+        n -= half;
+    }
+    int rec = base - m_startIp.constData();
+
+    if (m_startIp.at(rec) <= ip && ip <= read4(m_endOffset.at(rec))) {
+        QPair<QString, QString> * location = m_cache.object(rec);
+        if (location != NULL) {
+            country = location->first;
+            city = location->second;
+            return true;
+        }
+        readRecord(m_endOffset.at(rec) + 4, country, city);
         //country.replace( country.find( "CZ88.NET", 0, FALSE ), 8, "" );
-        if ((rec = city.indexOf("CZ88.NET", 0, Qt::CaseInsensitive)) >= 0)
-            city.replace(rec, 8, "");
-
+        int pos;
+        if ((pos = city.indexOf("CZ88.NET", 0, Qt::CaseInsensitive)) >= 0)
+            city.replace(pos, 8, "");
+        m_cache.insert(rec, new QPair<QString, QString>(country, city));
     } else {// not in this range... miss
         country = "unknown"; city = "";
     }// if ip_start<=ip<=ip_end
@@ -1,40 +1,47 @@
 #ifndef QTERMIPLOCATION_H
 #define QTERMIPLOCATION_H
 
-#include <stdio.h>
-#include <stdlib.h>
-//Added by qt3to4:
+#include <QtCore/QCache>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QVector>
 
 class QString;
 class QTextCodec;
-typedef unsigned long uint32;
 namespace QTerm
 {
-struct _ip_finder {
-    uint32     offset_first_start_ip;      // first abs offset of start ip
-    uint32     offset_last_start_ip;       // last abs offset of start ip
-    uint32     cur_start_ip;               // start ip of current search range
-    uint32     cur_end_ip;                 // end ip of current search range
-    uint32     offset_cur_end_ip;          // where is the current end ip saved
-    FILE *ipfp;                        // IO Channel to read file
-};// struct _ip_finder
 
+/*
+ * Looks up QQWry.dat, shared by all windows.  The file is mapped once,
+ * the start ip of every range is decoded into an array when it is opened
+ * and the locations found last are kept decoded.
+ */
 class IPLocation
 {
 public:
-    IPLocation(QString& pathLib);
+    static IPLocation * instance();
     ~IPLocation();
-    _ip_finder *f;
     bool getLocation(QString& url, QString& country, QString& city);
     bool haveFile();
 protected:
-    bool fileExist;
-    uint32 byteArrayToInt(char *ip, int count);
-    void readFrom(FILE *fp, uint32 offset, char *buf, int len);
-    int readLineFrom(FILE *fp, uint32 offset, QString& ret_str);
-    uint32 getString(FILE *fp, uint32 offset, uint32 lastoffset, QString& str, unsigned int flag);
-    void getCountryCity(FILE *fp, uint32 offset, QString& country, QString& city);
-    void setIpRange(int rec_no, _ip_finder *f);
+    IPLocation();
+    quint32 read3(quint32 offset);
+    quint32 read4(quint32 offset);
+    int rawLength(quint32 offset);
+    QString readString(quint32 offset);
+    void readRecord(quint32 offset, QString& country, QString& city);
+
+    static IPLocation * m_Instance;
+    QMutex m_mutex;
+    QFile m_file;
+    const uchar * m_data;
+    quint32 m_size;
+    // start ip of every range and where its end ip is kept
+    QVector<quint32> m_startIp;
+    QVector<quint32> m_endOffset;
+    // country and city by range
+    QCache<int, QPair<QString, QString> > m_cache;
     QTextCodec * m_codec;
 };
 
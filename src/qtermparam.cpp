@@ -62,6 +62,7 @@ Param::Param()
 	m_mapParam["retrytimes"] = -1;
 	m_mapParam["loadscript"] = false;
 	m_mapParam["scriptfile"] = "";
+	m_mapParam["triggers"] = "";
 
 	m_mapParam["menutype"] = 2;
 	m_mapParam["menucolor"] = QColor(0,65,132);
@@ -1,640 +1,528 @@
-//#include "qterm.h"
-
-#ifdef HAVE_CONFIG_H
-#include <config.h>
-#endif
-
-#ifdef HAVE_PYTHON
 #include <Python.h>
+#include <structmember.h>
 
-// #include <qapplication.h>
-// #include <qdir.h>
-// #include <qfile.h>
-
+#include "qtermpython.h"
 #include "qtermwindow.h"
 #include "qtermbuffer.h"
 #include "qtermtextline.h"
-#include "qtermtelnet.h"
-#include "qtermparam.h"
-#include "qtermbbs.h"
-//Added by qt3to4:
-#include <QCustomEvent>
-#include <QTextStream>
-#include <QApplication>
-#include <QDir>
-#include <QFile>
-#include <QByteArray>
-
-/* **************************************************************************
+
+#include <QtCore/QFile>
+#include <QtCore/QMutexLocker>
+#include <QtDebug>
+
+#include <limits.h>
+
+namespace QTerm
+{
+
+/* ************************************************************************
  *
- *				Pythons Embedding
+ *                  The qterm module, run on script threads
  *
- * ***************************************************************************/
-extern QString pathCfg;
-
-QString getException()
-{
-	PyObject *pType=NULL, *pValue=NULL, *pTb=NULL, *pName, *pTraceback;
-
-    PyErr_Fetch(&pType, &pValue, &pTb);
-
-    pName = PyString_FromString("traceback");
-    pTraceback = PyImport_Import(pName);
-    Py_DECREF(pName);
-	
-	if(pTraceback==NULL)
-		return "General Error in Python Callback";
-
-    pName = PyString_FromString("format_exception");
-    PyObject *pRes = PyObject_CallMethodObjArgs(pTraceback, pName,pType,pValue,pTb,NULL);
-    Py_DECREF(pName);
-	
-	Py_DECREF(pTraceback);
-
-    Py_XDECREF(pType);
-    Py_XDECREF(pValue);
-    Py_XDECREF(pTb);
-
-	if(pRes==NULL)
-		return "General Error in Python Callback";
-	
-    pName = PyString_FromString("string");
-    PyObject *pString = PyImport_Import(pName);
-    Py_DECREF(pName);
-
-	if(pString==NULL)
-		return "General Error in Python Callback";
-
-    pName = PyString_FromString("join");
-    PyObject *pErr = PyObject_CallMethodObjArgs(pString, pName, pRes,NULL);
-    Py_DECREF(pName);
-
-    Py_DECREF(pString);
-    Py_DECREF(pRes);
-
-	if(pErr==NULL)
-		return "General Error in Python Callback";
-
-    QString str(PyString_AsString(pErr));
-	Py_DECREF(pErr);
-
-	return str;
-}
-
-QString getErrOutputFile(Window* lp)
-{
-	// file name
-	QString str2;
-	str2.setNum(long(lp));
-	str2 += ".err";
-	// path
-	return pathCfg+str2;
-}
-
-// copy current artcle for back compatible use only
-// for new coder please use getArticle
-static PyObject *qterm_copyArticle(PyObject *, PyObject *args)
-{
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-
-	Window *pWin=(Window*)lp;
-
-	QStringList strList;
-	QString strArticle;
-	while(1)
-	{
-		// check it there is duplicated string
-		// it starts from the end in the range of one screen height
-		// so this is a non-greedy match
-		QString strTemp = pWin->stripWhitespace(
-				pWin->m_pBuffer->screen(0)->getText());
-		int i=0;
-		int start=0;
-		for(QStringList::Iterator it=strList.fromLast();
-	it!=strList.begin(), i < pWin->m_pBuffer->line()-1; // not exceeeding the last screen
-			--it, i++)
-		{
-			if(*it!=strTemp)
-				continue;
-			QStringList::Iterator it2 = it;
-			bool dup=true;
-			// match more to see if its duplicated
-			for(int j=0; j<=i; j++, it2++)
-			{
-				QString str1 = pWin->stripWhitespace(
-					pWin->m_pBuffer->screen(j)->getText());
-				if(*it2!=str1)
-				{
-					dup = false;
-					break;
-				}
-			}
-			if(dup)
-			{
-				// set the start point
-				start = i+1;
-				break;
-			}
-		}
-		// add new lines
-		for(i=start;i<pWin->m_pBuffer->line()-1;i++)
-			strList+=pWin->stripWhitespace(
-			pWin->m_pBuffer->screen(i)->getText());
-
-		// the end of article
-		if( pWin->m_pBuffer->screen(
-		pWin->m_pBuffer->line()-1)->getText().find("%") == -1 )
-			break;
-		// continue
-		pWin->m_pTelnet->write(" ", 1);
-		
-		if(!pWin->m_wcWaiting.wait(10000))	// timeout
-			break;
-	}
-	#if defined(_OS_WIN32_) || defined(Q_OS_WIN32)
-	strArticle = strList.join("\r\n");
-	#else
-	strArticle = strList.join("\n");
-	#endif
-	
-	PyObject *py_text = PyString_FromString(strArticle.toLocal8Bit);
-
-	Py_INCREF(py_text);
-	return py_text;
-}
-
-static PyObject *qterm_getArticle(PyObject *, PyObject *args)
-{
-	long lp;
-	int timeout;
-	int succeed=1;
-
-	if (!PyArg_ParseTuple(args, "li", &lp, &timeout))
-		return NULL;
-
-	Window *pWin=(Window*)lp;
-
-	QStringList strList;
-	QString strArticle;
-	while(1)
-	{
-		// check it there is duplicated string
-		// it starts from the end in the range of one screen height
-		// so this is a non-greedy match
-		QString strTemp = pWin->stripWhitespace(
-				pWin->m_pBuffer->screen(0)->getText());
-		int i=0;
-		int start=0;
-		for(QStringList::Iterator it=strList.fromLast();
-	it!=strList.begin(), i < pWin->m_pBuffer->line()-1; // not exceeeding the last screen
-			--it, i++)
-		{
-			if(*it!=strTemp)
-				continue;
-			QStringList::Iterator it2 = it;
-			bool dup=true;
-			// match more to see if its duplicated
-			for(int j=0; j<=i; j++, it2++)
-			{
-				QString str1 = pWin->stripWhitespace(
-					pWin->m_pBuffer->screen(j)->getText());
-				if(*it2!=str1)
-				{
-					dup = false;
-					break;
-				}
-			}
-			if(dup)
-			{
-				// set the start point
-				start = i+1;
-				break;
-			}
-		}
-		// add new lines
-		for(i=start;i<pWin->m_pBuffer->line()-1;i++)
-			strList+=pWin->stripWhitespace(
-			pWin->m_pBuffer->screen(i)->getText());
-
-		// the end of article
-		if( pWin->m_pBuffer->screen(
-		pWin->m_pBuffer->line()-1)->getText().find("%") == -1 )
-			break;
-		// continue
-		pWin->m_pTelnet->write(" ", 1);
-		
-		if(!pWin->m_wcWaiting.wait(timeout*1000))	// timeout
-		{
-			succeed=0;
-			break;
-		}
-	}
-	#if defined(_OS_WIN32_) || defined(Q_OS_WIN32)
-	strArticle = strList.join("\r\n");
-	#else
-	strArticle = strList.join("\n");
-	#endif
-	
-	PyObject *py_res = Py_BuildValue("si",(const char *)strArticle.toLocal8Bit(), succeed);
-	
-	Py_INCREF(py_res);
-
-	return py_res;
-
-}
-
-static PyObject *qterm_formatError(PyObject *, PyObject *args)
-{
-	long lp;
-	
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-
-	QString strErr;
-	QString filename = getErrOutputFile((Window*)lp);
-
-	QDir d;
-	if(d.exists(filename))
-	{
-		QFile file(filename);
-		file.open(QIODevice::ReadOnly);
-		QTextStream is( &file );
-        while ( !is.atEnd() ) 
-		{
-			strErr += is.readLine(); // line of text excluding '\n'
-			strErr += '\n'; 
-		}
-		file.close();
-		d.remove( filename );
-	}
-
-	if( !strErr.isEmpty() )
-	{
-		((Window*)lp)->m_strPythonError = strErr;
-		qApp->postEvent( (Window*)lp, new QCustomEvent(PYE_ERROR));
-	}
-	else
-		qApp->postEvent( (Window*)lp, new QCustomEvent(PYE_FINISH));
-
-
-	Py_INCREF(Py_None);
-	return Py_None;
-}
-
-// caret x
-static PyObject *qterm_caretX(PyObject *, PyObject *args)
-{
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	int x = ((Window*)lp)->m_pBuffer->caret().x();
-	PyObject * py_x =Py_BuildValue("i",x);
-	Py_INCREF(py_x);
-	return py_x;
-}
-
-// caret y
-static PyObject *qterm_caretY(PyObject *, PyObject *args)
-{
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	int y = ((Window*)lp)->m_pBuffer->caret().y();
-	PyObject * py_y =Py_BuildValue("i",y);
-	Py_INCREF(py_y);
-	return py_y;
+ * ************************************************************************/
+
+static PythonThread * currentThread()
+{
+    PythonThread * thread = qobject_cast<PythonThread *>(QThread::currentThread());
+    if (thread == NULL)
+        PyErr_SetString(PyExc_RuntimeError, "qterm is only available to the thread of the script");
+    return thread;
+}
 
+static PyObject * fromQString(const QString & str)
+{
+    int order = Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? -1 : 1;
+    return PyUnicode_DecodeUTF16((const char *)str.utf16(), str.size() * 2, NULL, &order);
 }
 
-// columns
-static PyObject *qterm_columns(PyObject *, PyObject *args)
+// a list of the text of count lines from first, all if count is negative
+static PyObject * textList(const PythonThread::Screen & screen, int first, int count)
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
+    first = qBound(0, first, screen.rows);
+    int last = count < 0 ? screen.rows : qMin(screen.rows, first + count);
+    PyObject * list = PyList_New(last - first);
+    if (list == NULL)
+        return NULL;
+    for (int i = first; i < last; i++) {
+        PyObject * text = fromQString(screen.text.at(i));
+        if (text == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i - first, text);
+    }
+    return list;
+}
+
+// a copy of the screen, the grid of cells is shared with the one taken
+// from the window until that is updated
+struct ScreenObject {
+    PyObject_HEAD
+    PythonThread::Screen * screen;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+};
 
-	int columns = ((Window*)lp)->m_pBuffer->columns();
-	PyObject * py_columns = Py_BuildValue("i",columns);
-	
-	Py_INCREF(py_columns);
-	return py_columns;
+static PyTypeObject ScreenType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
 
+static void screen_dealloc(PyObject * self)
+{
+    delete ((ScreenObject *)self)->screen;
+    Py_TYPE(self)->tp_free(self);
 }
 
-// rows
-static PyObject *qterm_rows(PyObject *, PyObject *args)
+// rows x columns x (color, attribute), read only
+static int screen_getbuffer(PyObject * self, Py_buffer * view, int flags)
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	
-	int rows = ((Window*)lp)->m_pBuffer->line();
-	PyObject *py_rows = Py_BuildValue("i",rows);
+    ScreenObject * object = (ScreenObject *)self;
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "the screen is read only");
+        view->obj = NULL;
+        return -1;
+    }
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = (void *)object->screen->cells.constData();
+    view->len = object->screen->cells.size();
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? (char *)"B" : NULL;
+    if (flags & PyBUF_ND) {
+        view->ndim = 3;
+        view->shape = object->shape;
+    } else {
+        view->ndim = 1;
+        view->shape = NULL;
+    }
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? object->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs screenBuffer = {
+    screen_getbuffer,
+    NULL
+};
 
-	Py_INCREF(py_rows);
-	return py_rows;
+static PyObject * screen_lines(PyObject * self, PyObject * args)
+{
+    int first = 0;
+    int count = -1;
+    if (!PyArg_ParseTuple(args, "|ii", &first, &count))
+        return NULL;
+    return textList(*((ScreenObject *)self)->screen, first, count);
 }
 
-// sned string to server
-static PyObject *qterm_sendString(PyObject *, PyObject *args)
+static PyObject * screen_caret(PyObject * self, PyObject *)
 {
-	char *pstr;
-	long lp;
-	int len;
+    const PythonThread::Screen * screen = ((ScreenObject *)self)->screen;
+    return Py_BuildValue("(ii)", screen->caretX, screen->caretY);
+}
 
-	if (!PyArg_ParseTuple(args, "ls", &lp, &pstr))
-		return NULL;
-	
-	len = strlen(pstr);
+static PyMethodDef screenMethods[] = {
+    {"lines", screen_lines, METH_VARARGS,
+        "lines([first, count]) -> text of the lines as a list"},
+    {"caret", screen_caret, METH_NOARGS,
+        "caret() -> (x, y)"},
+    {NULL, NULL, 0, NULL}
+};
 
-	((Window*)lp)->m_pTelnet->write(pstr,len);
+static PyMemberDef screenMembers[] = {
+    {(char *)"rows", T_PYSSIZET, offsetof(ScreenObject, shape), READONLY, NULL},
+    {(char *)"columns", T_PYSSIZET, offsetof(ScreenObject, shape) + sizeof(Py_ssize_t), READONLY, NULL},
+    {NULL, 0, 0, 0, NULL}
+};
 
-	Py_INCREF(Py_None);
-	return Py_None;
+static PyObject * takeScreen(PythonThread * thread)
+{
+    ScreenObject * object = PyObject_New(ScreenObject, &ScreenType);
+    if (object == NULL)
+        return NULL;
+    object->screen = new PythonThread::Screen;
+    Py_BEGIN_ALLOW_THREADS
+    *object->screen = thread->screen();
+    Py_END_ALLOW_THREADS
+    object->shape[0] = object->screen->rows;
+    object->shape[1] = object->screen->columns;
+    object->shape[2] = 2;
+    object->strides[0] = object->screen->columns * 2;
+    object->strides[1] = 2;
+    object->strides[2] = 1;
+    return (PyObject *)object;
 }
 
-// same as above except parsing string first "\n" "^p" etc
-static PyObject *qterm_sendParsedString(PyObject *, PyObject *args)
+static PyObject * qterm_screen(PyObject *, PyObject *)
 {
-	char *pstr;
-	long lp;
-	int len;
-
-	if (!PyArg_ParseTuple(args, "ls", &lp, &pstr))
-		return NULL;
-	len = strlen(pstr);
-	
-	((Window*)lp)->sendParsedString(pstr);
-
-	Py_INCREF(Py_None);
-	return Py_None;
+    PythonThread * thread = currentThread();
+    if (thread == NULL)
+        return NULL;
+    return takeScreen(thread);
 }
 
-// get text at line
-static PyObject *qterm_getText(PyObject *, PyObject *args)
+static PyObject * qterm_getLines(PyObject *, PyObject * args)
 {
-	long lp;
-	int line;
-	if (!PyArg_ParseTuple(args, "li", &lp, &line))
-		return NULL;
-	QByteArray cstr = ((Window*)lp)->m_pBuffer->screen(line)->getText();
+    int first = 0;
+    int count = -1;
+    if (!PyArg_ParseTuple(args, "|ii", &first, &count))
+        return NULL;
+    PythonThread * thread = currentThread();
+    if (thread == NULL)
+        return NULL;
+    PythonThread::Screen screen;
+    Py_BEGIN_ALLOW_THREADS
+    screen = thread->screen();
+    Py_END_ALLOW_THREADS
+    return textList(screen, first, count);
+}
 
-	PyObject *py_text = PyString_FromString(cstr);
+static PyObject * qterm_getText(PyObject *, PyObject * args)
+{
+    int line;
+    if (!PyArg_ParseTuple(args, "i", &line))
+        return NULL;
+    PythonThread * thread = currentThread();
+    if (thread == NULL)
+        return NULL;
+    PythonThread::Screen screen;
+    Py_BEGIN_ALLOW_THREADS
+    screen = thread->screen();
+    Py_END_ALLOW_THREADS
+    if (line < 0 || line >= screen.rows) {
+        PyErr_SetString(PyExc_IndexError, "line out of the screen");
+        return NULL;
+    }
+    return fromQString(screen.text.at(line));
+}
 
-	Py_INCREF(py_text);
-	return py_text;
+// Script->Stop ends the script with SystemExit at its next wait or send
+static bool stopped(PythonThread * thread)
+{
+    if (!thread->isStopped())
+        return false;
+    PyErr_SetNone(PyExc_SystemExit);
+    return true;
 }
 
-// get text with attributes
-static PyObject *qterm_getAttrText(PyObject *, PyObject *args)
+static PyObject * qterm_waitPage(PyObject *, PyObject * args)
 {
-	long lp;
-	int line;
-	if (!PyArg_ParseTuple(args, "li", &lp, &line))
-		return NULL;
+    double timeout = 10;
+    if (!PyArg_ParseTuple(args, "|d", &timeout))
+        return NULL;
+    PythonThread * thread = currentThread();
+    if (thread == NULL || stopped(thread))
+        return NULL;
+    int msecs = timeout < 0 ? -1 : (int)qMin(timeout * 1000, (double)INT_MAX);
+    bool ready;
+    Py_BEGIN_ALLOW_THREADS
+    ready = thread->waitPage(msecs);
+    Py_END_ALLOW_THREADS
+    if (stopped(thread))
+        return NULL;
+    return PyBool_FromLong(ready);
+}
 
-	QByteArray cstr = ((Window*)lp)->m_pBuffer->screen(line)->getAttrText();
+static PyObject * sendText(PyObject * args, bool parsed)
+{
+    const char * str;
+    if (!PyArg_ParseTuple(args, "s", &str))
+        return NULL;
+    PythonThread * thread = currentThread();
+    if (thread == NULL || stopped(thread))
+        return NULL;
+    thread->send(QString::fromUtf8(str), parsed);
+    Py_RETURN_NONE;
+}
 
-	PyObject *py_text = PyString_FromString(cstr);
+static PyObject * qterm_sendString(PyObject *, PyObject * args)
+{
+    return sendText(args, false);
+}
 
-	Py_INCREF(py_text);
-	return py_text;
+// escapes as in prelogin, "^M" and such
+static PyObject * qterm_sendParsedString(PyObject *, PyObject * args)
+{
+    return sendText(args, true);
 }
 
-// is host connected
-static PyObject *qterm_isConnected(PyObject *, PyObject *args)
+static PyObject * qterm_isConnected(PyObject *, PyObject *)
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	
-	bool connected = ((Window*)lp)->isConnected();
-	PyObject * py_connected =Py_BuildValue("i",connected?1:0);
+    PythonThread * thread = currentThread();
+    if (thread == NULL)
+        return NULL;
+    bool connected;
+    Py_BEGIN_ALLOW_THREADS
+    connected = thread->screen().connected;
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(connected);
+}
 
-	Py_INCREF(py_connected);
-	return py_connected;
+static PyObject * qterm_reconnect(PyObject *, PyObject *)
+{
+    PythonThread * thread = currentThread();
+    if (thread == NULL)
+        return NULL;
+    thread->requestReconnect();
+    Py_RETURN_NONE;
 }
 
-// disconnect from host
-static PyObject *qterm_disconnect(PyObject *, PyObject *args)
+static PyObject * qterm_disconnect(PyObject *, PyObject *)
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	
-	((Window*)lp)->disconnect();
-	
-	Py_INCREF(Py_None);
-	return Py_None;
+    PythonThread * thread = currentThread();
+    if (thread == NULL)
+        return NULL;
+    thread->requestDisconnect();
+    Py_RETURN_NONE;
 }
 
-// reconnect to host
-static PyObject *qterm_reconnect(PyObject *, PyObject *args)
+static PyMethodDef qtermMethods[] = {
+    {"screen", qterm_screen, METH_NOARGS,
+        "screen() -> a copy of the screen, its cells readable as a buffer"},
+    {"getLines", qterm_getLines, METH_VARARGS,
+        "getLines([first, count]) -> text of the lines as a list"},
+    {"getText", qterm_getText, METH_VARARGS,
+        "getText(line) -> text of the line"},
+    {"waitPage", qterm_waitPage, METH_VARARGS,
+        "waitPage([timeout]) -> False if no page is complete within timeout seconds"},
+    {"sendString", qterm_sendString, METH_VARARGS,
+        "send string to server"},
+    {"sendParsedString", qterm_sendParsedString, METH_VARARGS,
+        "send string with escape"},
+    {"isConnected", qterm_isConnected, METH_NOARGS,
+        "connected to server or not"},
+    {"reconnect", qterm_reconnect, METH_NOARGS,
+        "reconnect"},
+    {"disconnect", qterm_disconnect, METH_NOARGS,
+        "disconnect from server"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyModuleDef qtermModule = {
+    PyModuleDef_HEAD_INIT,
+    "qterm",
+    "The window running the script",
+    -1,
+    qtermMethods,
+    NULL, NULL, NULL, NULL
+};
+
+static PyObject * initModule()
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	
-	((Window*)lp)->reconnect();
-	
-	Py_INCREF(Py_None);
-	return Py_None;
+    ScreenType.tp_name = "qterm.Screen";
+    ScreenType.tp_basicsize = sizeof(ScreenObject);
+    ScreenType.tp_dealloc = screen_dealloc;
+    ScreenType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ScreenType.tp_doc = "A copy of the screen";
+    ScreenType.tp_as_buffer = &screenBuffer;
+    ScreenType.tp_methods = screenMethods;
+    ScreenType.tp_members = screenMembers;
+    if (PyType_Ready(&ScreenType) < 0)
+        return NULL;
+
+    PyObject * module = PyModule_Create(&qtermModule);
+    if (module == NULL)
+        return NULL;
+    Py_INCREF(&ScreenType);
+    PyModule_AddObject(module, "Screen", (PyObject *)&ScreenType);
+    return module;
 }
 
-// bbs encoding 0-GBK 1-BIG5
-static PyObject *qterm_getBBSCodec(PyObject *, PyObject *args)
+// the traceback as python prints it
+static QString getException()
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	
-	PyObject *py_codec = PyString_FromString(
-					((Window*)lp)->m_param.m_nBBSCode==0?"GBK":"Big5");
-	Py_INCREF(py_codec);
+    PyObject * type = NULL;
+    PyObject * value = NULL;
+    PyObject * traceback = NULL;
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+
+    QString result = "General Error in Python Script";
+    PyObject * module = PyImport_ImportModule("traceback");
+    if (module != NULL) {
+        PyObject * lines = PyObject_CallMethod(module, (char *)"format_exception", (char *)"OOO",
+                                               type, value ? value : Py_None, traceback ? traceback : Py_None);
+        if (lines != NULL) {
+            PyObject * empty = PyUnicode_FromString("");
+            PyObject * text = PyUnicode_Join(empty, lines);
+            if (text != NULL) {
+                result = QString::fromUtf8(PyUnicode_AsUTF8(text));
+                Py_DECREF(text);
+            }
+            Py_DECREF(empty);
+            Py_DECREF(lines);
+        }
+        Py_DECREF(module);
+    }
+    PyErr_Clear();
+    Py_XDECREF(type);
+    Py_XDECREF(value);
+    Py_XDECREF(traceback);
+    return result;
+}
+
+/* ************************************************************************
+ *
+ *                              PythonThread
+ *
+ * ************************************************************************/
 
-	return py_codec;
+PythonThread::PythonThread(Window * window, const QString & filename)
+    : m_window(window), m_filename(filename), m_mutex(), m_pageReady(), m_screen(),
+      m_pages(0), m_seen(0), m_stop(false)
+{
 }
 
-// host address
-static PyObject *qterm_getAddress(PyObject *, PyObject *args)
+PythonThread::~PythonThread()
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
-	
-	PyObject *py_addr = PyString_FromString(
-					((Window*)lp)->m_param.m_strAddr.toLocal8Bit());
-	Py_INCREF(py_addr);
-	return py_addr;
 }
 
-// host port number
-static PyObject *qterm_getPort(PyObject *, PyObject *args)
+bool PythonThread::initialize()
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
+    if (Py_IsInitialized())
+        return true;
+    PyImport_AppendInittab("qterm", initModule);
+    Py_InitializeEx(0);
+    if (!Py_IsInitialized())
+        return false;
+#if PY_VERSION_HEX < 0x03070000
+    PyEval_InitThreads();
+#endif
+    // the GUI thread never runs python, the scripts take the lock
+    PyEval_SaveThread();
+    return true;
+}
 
-	PyObject *py_port = Py_BuildValue("i", ((Window*)lp)->m_param.m_uPort);
-	Py_INCREF(py_port);
-	return py_port;
+void PythonThread::updateScreen(bool pageComplete)
+{
+    Buffer * buffer = m_window->m_pBuffer;
+    int rows = buffer->line();
+    int columns = buffer->columns();
+
+    QMutexLocker locker(&m_mutex);
+    if (m_stop)
+        return;
+    Screen & screen = m_screen;
+    if (screen.rows != rows || screen.columns != columns) {
+        screen.rows = rows;
+        screen.columns = columns;
+        screen.revisions.fill(~quint64(0), rows);
+        screen.text.clear();
+        for (int i = 0; i < rows; i++)
+            screen.text << QString();
+        screen.cells = QByteArray(rows * columns * 2, '\0');
+    }
+    for (int y = 0; y < rows; y++) {
+        TextLine * line = buffer->screen(y);
+        if (line == NULL || line->revision() == screen.revisions.at(y))
+            continue;
+        screen.revisions[y] = line->revision();
+        screen.text[y] = line->getText();
+        QByteArray color = line->getColor();
+        QByteArray attr = line->getAttr();
+        char * cell = screen.cells.data() + y * columns * 2;
+        for (int x = 0; x < columns; x++) {
+            *cell++ = x < color.size() ? color.at(x) : '\0';
+            *cell++ = x < attr.size() ? attr.at(x) : '\0';
+        }
+    }
+    screen.caretX = buffer->caret().x();
+    screen.caretY = buffer->caret().y();
+    screen.connected = m_window->isConnected();
+    if (pageComplete) {
+        m_pages++;
+        m_pageReady.wakeAll();
+    }
 }
 
-// connection protocol 0-telnet 1-SSH1 2-SSH2
-static PyObject *qterm_getProtocol(PyObject *, PyObject *args)
+void PythonThread::stop()
 {
-	long lp;
-	if (!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
+    QMutexLocker locker(&m_mutex);
+    m_stop = true;
+    m_pageReady.wakeAll();
+}
 
-	PyObject *py_port = Py_BuildValue("i", ((Window*)lp)->m_param.m_nProtocolType);
-	Py_INCREF(py_port);
-	return py_port;
+PythonThread::Screen PythonThread::screen()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_screen;
 }
 
-// key to reply msg
-static PyObject *qterm_getReplyKey(PyObject *, PyObject *args)
+bool PythonThread::waitPage(int msecs)
 {
-	long lp;
-	if(!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
+    QMutexLocker locker(&m_mutex);
+    while (m_seen == m_pages && !m_stop) {
+        if (!m_pageReady.wait(&m_mutex, msecs < 0 ? ULONG_MAX : (unsigned long)msecs))
+            break;
+    }
+    bool ready = m_seen != m_pages && !m_stop;
+    m_seen = m_pages;
+    return ready;
+}
 
-	PyObject *py_key = PyString_FromString(((Window*)lp)->m_param.m_strReplyKey.toLocal8Bit());
-	Py_INCREF(py_key);
-	return py_key;
+bool PythonThread::isStopped()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stop;
 }
 
-// url under mouse 
-static PyObject *qterm_getURL(PyObject *, PyObject *args)
+void PythonThread::send(const QString & string, bool parsed)
 {
-	long lp;
-	if(!PyArg_ParseTuple(args, "l", &lp))
-		return NULL;
+    if (isStopped())
+        return;
+    if (parsed)
+        emit parsedStringSent(string);
+    else
+        emit stringSent(string);
+}
 
-	PyObject *py_url = PyString_FromString( ((Window*)lp)->m_pBBS->getUrl());
-	Py_INCREF(py_url);
-	return py_url;
+void PythonThread::requestReconnect()
+{
+    if (!isStopped())
+        emit reconnectRequested();
 }
-
-// preview image link
-static PyObject *qterm_previewImage(PyObject *, PyObject *args)
-{
-	long lp;
-	char *url;
-	if (!PyArg_ParseTuple(args, "ls", &lp, &url))
-		return NULL;
-	
-	((Window*)lp)->getHttpHelper(url,true);
-	
-	Py_INCREF(Py_None);
-	return Py_None;
-
-}
-
-// convert string from UTF8 to specified encoding
-static PyObject *qterm_fromUTF8(PyObject *, PyObject *args)
-{
-	char *str, *enc;
-	if (!PyArg_ParseTuple(args, "ss", &str, &enc))
-		return NULL;
-	QTextCodec *encodec = QTextCodec::codecForName(enc);
-	QTextCodec *utf8 = QTextCodec::codecForName("utf8");
-	
-	PyObject *py_str = PyString_FromString(
-					encodec->fromUnicode(utf8->toUnicode(str)));
-	Py_INCREF(py_str);
-	return py_str;
-}
-
-// convert string from specified encoding to UTF8
-static PyObject *qterm_toUTF8(PyObject *, PyObject *args)
+
+void PythonThread::requestDisconnect()
 {
-	char *str, *enc;
-	if (!PyArg_ParseTuple(args, "ss", &str, &enc))
-		return NULL;
-	QTextCodec *encodec = QTextCodec::codecForName(enc);
-	QTextCodec *utf8 = QTextCodec::codecForName("utf8");
-	
-	PyObject *py_str = PyString_FromString(
-					utf8->fromUnicode(encodec->toUnicode(str)));
-	Py_INCREF(py_str);
-	return py_str;
-}
-
-
-PyMethodDef qterm_methods[] = {
-	{"formatError",		(PyCFunction)qterm_formatError,			METH_VARARGS,	
-			"get the traceback info"},
-	
-	{"getArticle",		(PyCFunction)qterm_getArticle,			METH_VARARGS,
-			"copy current article"},
-
-	{"copyArticle",		(PyCFunction)qterm_copyArticle,			METH_VARARGS,
-			"copy current article (obsolete)"},
-
-	{"getText",		(PyCFunction)qterm_getText,			METH_VARARGS,
-			"get text at line#"},
+    if (!isStopped())
+        emit disconnectRequested();
+}
 
-	{"getAttrText",		(PyCFunction)qterm_getAttrText,			METH_VARARGS,
-			"get attr text at line#"},
-
-	{"sendString",		(PyCFunction)qterm_sendString,			METH_VARARGS,
-			"send string to server"},
-	
-	{"sendParsedString",(PyCFunction)qterm_sendParsedString,		METH_VARARGS,
-			"send string with escape"},
-
-	{"caretX",		(PyCFunction)qterm_caretX,			METH_VARARGS,
-			"caret x"},
-	
-	{"caretY",		(PyCFunction)qterm_caretY,			METH_VARARGS,
-			"caret y"},
-
-	{"columns",		(PyCFunction)qterm_columns,			METH_VARARGS,
-			"screen width"},
-	
-	{"rows",		(PyCFunction)qterm_rows,			METH_VARARGS,
-			"screen height"},
-	
-	{"isConnected",		(PyCFunction)qterm_isConnected,			METH_VARARGS,
-			"connected to server or not"},
-	
-	{"disconnect",		(PyCFunction)qterm_disconnect,			METH_VARARGS,
-			"disconnect from server"},
-	
-	{"reconnect",		(PyCFunction)qterm_reconnect,			METH_VARARGS,
-			"reconnect"},
-
-	{"getBBSCodec",		(PyCFunction)qterm_getBBSCodec,			METH_VARARGS,
-			"get the bbs encoding, GBK or Big5"},
-	
-	{"getAddress",		(PyCFunction)qterm_getAddress,			METH_VARARGS,
-			"get the bbs address"},
-
-	{"getPort",		(PyCFunction)qterm_getPort,			METH_VARARGS,
-			"get the bbs port number"},
-
-	{"getProtocol",		(PyCFunction)qterm_getPort,			METH_VARARGS,
-			"get the bbs protocol, 0/1/2 TELNET/SSH1/SSH2"},
-	
-	{"getReplyKey",		(PyCFunction)qterm_getReplyKey,			METH_VARARGS,
-			"get the key to reply messages"},
-
-	{"getURL",		(PyCFunction)qterm_getURL,			METH_VARARGS,
-			"get the url string under mouse"},
-
-	{"previewImage",	(PyCFunction)qterm_previewImage,		METH_VARARGS,
-			"preview the image link"},
-
-	{"fromUTF8",		(PyCFunction)qterm_fromUTF8,			METH_VARARGS,
-			"decode from utf8 to string in specified codec"},
-	
-	{"toUTF8",		(PyCFunction)qterm_toUTF8,			METH_VARARGS,
-			"decode from string in specified codec to utf8"},
-
-	{NULL,	 			(PyCFunction)NULL, 						0, 				NULL}
-};
-#endif //HAVE_PYTHON
+void PythonThread::run()
+{
+    QFile file(m_filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit error(tr("Cannot read %1").arg(m_filename));
+        return;
+    }
+    QByteArray source = file.readAll();
+    file.close();
+
+    PyGILState_STATE state = PyGILState_Ensure();
+    PyObject * globals = PyDict_New();
+    PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+    PyObject * name = PyUnicode_FromString("__main__");
+    PyDict_SetItemString(globals, "__name__", name);
+    Py_DECREF(name);
+
+    PyObject * result = NULL;
+    PyObject * code = Py_CompileString(source.constData(), QFile::encodeName(m_filename).constData(),
+                                       Py_file_input);
+    if (code != NULL) {
+        result = PyEval_EvalCode(code, globals, globals);
+        Py_DECREF(code);
+    }
+    if (result == NULL) {
+        if (PyErr_ExceptionMatches(PyExc_SystemExit))
+            PyErr_Clear();
+        else
+            emit error(getException());
+    }
+    Py_XDECREF(result);
+    Py_DECREF(globals);
+    PyGILState_Release(state);
+}
 
+} // namespace QTerm
+#include <moc_qtermpython.cpp>
@@ -1,9 +1,88 @@
-#include "qterm.h"
+#ifndef QTERMPYTHON_H
+#define QTERMPYTHON_H
 
-#ifdef HAVE_PYTHON
-#include <Python.h>
-extern QString getException();
-extern QString getErrOutputFile(Window *);
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
 
-extern PyMethodDef qterm_methods[];
-#endif
+namespace QTerm
+{
+class Window;
+
+/*
+ * Runs a Python script for a window on a thread of its own, the script
+ * imports the module "qterm" to read the screen and talk to the host.
+ *
+ * As for DAThread the buffer is only read on the GUI thread: after every
+ * update the window hands the thread a copy of the screen, where a line
+ * is copied again only when its revision has changed.  Colors and
+ * attributes of all cells are kept in one grid the script sees through
+ * the buffer protocol, text comes in batches of lines.  What the script
+ * sends is queued to the GUI thread.  The interpreter lock is released
+ * while the script waits for QTerm, and the GUI thread never takes it.
+ */
+class PythonThread : public QThread
+{
+    Q_OBJECT
+public:
+    struct Screen {
+        Screen() : rows(0), columns(0), caretX(0), caretY(0), connected(false) {}
+        int rows;
+        int columns;
+        QVector<quint64> revisions;
+        QStringList text;
+        QByteArray cells;   // color and attribute by row and column
+        int caretX;
+        int caretY;
+        bool connected;
+    };
+
+    PythonThread(Window * window, const QString & filename);
+    ~PythonThread();
+
+    // the interpreter is started once, on the GUI thread
+    static bool initialize();
+
+    // called on the GUI thread after the screen is updated
+    void updateScreen(bool pageComplete);
+    // waitPage() and the sends of the script raise SystemExit from now on,
+    // a script busy in code of its own runs on until it gets there
+    void stop();
+
+    // called by the script
+    Screen screen();
+    // false if no page was completed within msecs, negative waits forever
+    bool waitPage(int msecs);
+    bool isStopped();
+    void send(const QString & string, bool parsed);
+    void requestReconnect();
+    void requestDisconnect();
+
+signals:
+    void stringSent(const QString &);
+    void parsedStringSent(const QString &);
+    void reconnectRequested();
+    void disconnectRequested();
+    void error(const QString &);
+
+protected:
+    virtual void run();
+
+private:
+    Window * m_window;
+    QString m_filename;
+    QMutex m_mutex;
+    QWaitCondition m_pageReady;
+    Screen m_screen;
+    int m_pages;
+    int m_seen;
+    bool m_stop;
+};
+
+} // namespace QTerm
+
+#endif // QTERMPYTHON_H
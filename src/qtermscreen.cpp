@@ -16,6 +16,8 @@ AUTHOR:        kingson fiasco
 #include "qtermconvert.h"
 #include "qtermbuffer.h"
 #include "qtermbbs.h"
+#include "qtermsearch.h"
+#include "qtermhighlighter.h"
 #include "qtermframe.h"
 #include "qtermparam.h"
 #include "qtermtelnet.h"
@@ -870,6 +872,22 @@ void Screen::repaintScreen(QPaintEvent * pe)
 
 // draw a line with the specialAtter if given.
 // modified by hooey to draw part of the line.
+static bool isHit(const QVector<QPoint> & hits, int x)
+{
+    for (int i = 0; i < hits.size(); i++)
+        if (x >= hits.at(i).x() && x <= hits.at(i).y())
+            return true;
+    return false;
+}
+
+static int highlightAt(const QVector<Highlighter::Span> & spans, int x)
+{
+    for (int i = 0; i < spans.size(); i++)
+        if (x >= spans.at(i).first && x <= spans.at(i).last)
+            return spans.at(i).attr;
+    return -1;
+}
+
 void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool complete)
 {
     if (index >= m_pBuffer->lines()) {
@@ -885,6 +903,8 @@ void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool c
     char tempea = 0;
     short tempattr;
     bool bSelected;
+    bool bHit;
+    int nHighlight;
     bool bReverse = false;
     int startx;
     //qDebug() << "beginx: " << beginx << ", endx: " << endx << ", linelength: " << linelength;
@@ -922,6 +942,11 @@ void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool c
     if (m_ePaintState == Cursor && m_bCursor) {
         bReverse = true;
     }
+    int displayCode = m_pParam->m_mapParam["displaycode"].toInt();
+    // search matches and highlighted keywords are drawn over the line,
+    // the attributes are untouched
+    QVector<QPoint> hits = m_pWindow->m_pSearch->hits(index);
+    QVector<Highlighter::Span> spans = m_pWindow->m_pHighlighter->spans(pTextLine);
     for (int i = beginx; i < endx+1;i++) {
         int len = 0;
         startx = i;
@@ -930,6 +955,8 @@ void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool c
         if (i < attr.size())
             tempea = attr.at(i);
         bSelected = m_pBuffer->isSelected(QPoint(i, index), m_pWindow->m_bRectCopy);
+        bHit = !hits.isEmpty() && isHit(hits, i);
+        nHighlight = spans.isEmpty() ? -1 : highlightAt(spans, i);
         len = pTextLine->size(i);
         if ( (i+1) >= linelength) {
             len = 1;
@@ -941,6 +968,12 @@ void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool c
 
         if (bSelected) // selected area is text=color(0) background=color(7)
             tempattr = SETCOLOR(SETFG(0) | SETBG(7)) | SETATTR(NO_ATTR);
+        else if (bHit)
+            tempattr = SETCOLOR(SETFG(0) | SETBG(3)) | SETATTR(NO_ATTR);
+        else if (nHighlight != -1 && bReverse)
+            tempattr = SETCOLOR(GETCOLOR(nHighlight)) | SETATTR(SETREVERSE(GETATTR(nHighlight)));
+        else if (nHighlight != -1)
+            tempattr = nHighlight;
         else if (bReverse)
             tempattr = SETCOLOR(tempcp) | SETATTR(SETREVERSE(tempea));
         else
@@ -949,7 +982,7 @@ void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool c
         //qDebug() << "startx: " << startx << " i: " << i << " string: " << strShow;
         // There should be only one.
         // TODO: Rewrite this when we want to do more than char to char convert
-        strShow = Global::instance()->convert(pTextLine->getText(startx, len), (Global::Conversion)m_pParam->m_mapParam["displaycode"].toInt());
+        strShow = pTextLine->getShownText(startx, len, displayCode);
 
         if (strShow.isEmpty()) {
             qDebug("drawLine: empty string?");
@@ -966,7 +999,9 @@ void Screen::drawLine(QPainter& painter, int index, int beginx, int endx, bool c
             flags = RenderRight;
             charWidth = 1;
         } else if ( charWidth == 2) {
-            if (tempcp != color.at(i+1) || tempea != attr.at(i+1) || bSelected != m_pBuffer->isSelected(QPoint(i+1, index), m_pWindow->m_bRectCopy)) {
+            if (tempcp != color.at(i+1) || tempea != attr.at(i+1) || bSelected != m_pBuffer->isSelected(QPoint(i+1, index), m_pWindow->m_bRectCopy)
+                    || bHit != (!hits.isEmpty() && isHit(hits, i+1))
+                    || nHighlight != (spans.isEmpty() ? -1 : highlightAt(spans, i+1))) {
                 charWidth = 1;
                 flags = RenderLeft;
             } else {
@@ -0,0 +1,197 @@
+#include "qtermsearch.h"
+#include "qtermbuffer.h"
+#include "qtermtextline.h"
+
+#include <string.h>
+
+namespace QTerm
+{
+
+// one bit for every character and every pair of characters
+static inline void addFeature(quint64 * bits, uint h)
+{
+    h *= 0x9e3779b1u;
+    uint bit = h >> 24;
+    bits[bit >> 6] |= Q_UINT64_C(1) << (bit & 63);
+}
+
+BufferSearch::BufferSearch(Buffer * buffer, QObject * parent)
+    : QObject(parent), m_pBuffer(buffer), m_index(), m_indexBase(0),
+      m_pattern(), m_regex(false), m_re(), m_hits(), m_searched(0), m_rows()
+{
+    memset(&m_query, 0, sizeof(m_query));
+    connect(m_pBuffer, SIGNAL(bufferSizeChanged()), this, SLOT(update()));
+    update();
+}
+
+BufferSearch::~BufferSearch()
+{
+}
+
+BufferSearch::Signature BufferSearch::signature(const QString & text)
+{
+    Signature sig;
+    memset(&sig, 0, sizeof(sig));
+    const QChar * p = text.unicode();
+    uint prev = 0;
+    for (int i = 0; i < text.length(); i++) {
+        uint c = p[i].toCaseFolded().unicode();
+        addFeature(sig.bits, c);
+        if (i > 0)
+            addFeature(sig.bits, (prev << 16) | c);
+        prev = c;
+    }
+    return sig;
+}
+
+int BufferSearch::history()
+{
+    return m_pBuffer->lines() - m_pBuffer->line();
+}
+
+int BufferSearch::find(const QString & pattern, bool regex)
+{
+    clear();
+    if (pattern.isEmpty())
+        return 0;
+    if (regex) {
+        m_re = QRegExp(pattern, Qt::CaseInsensitive);
+        if (!m_re.isValid())
+            return 0;
+    } else
+        m_query = signature(pattern);
+    m_pattern = pattern;
+    m_regex = regex;
+    update();
+    return count();
+}
+
+void BufferSearch::clear()
+{
+    m_pattern.clear();
+    m_hits.clear();
+    m_searched = 0;
+    m_rows.clear();
+}
+
+int BufferSearch::count()
+{
+    if (m_pattern.isEmpty())
+        return 0;
+    int n = m_hits.size();
+    for (int y = history(); y < m_pBuffer->lines(); y++)
+        if (!hits(y).isEmpty())
+            n++;
+    return n;
+}
+
+// index the lines that scrolled into history since the last call and
+// search them if there is an active pattern
+void BufferSearch::update()
+{
+    qint64 dropped = m_pBuffer->dropped();
+    qint64 end = dropped + history();
+
+    if (dropped >= m_indexBase + m_index.size()) {
+        m_index.clear();
+        m_indexBase = dropped;
+    } else if (dropped - m_indexBase > m_index.size() / 2) {
+        // lines fall off one at a time, compact only now and then
+        m_index.remove(0, dropped - m_indexBase);
+        m_indexBase = dropped;
+    }
+    for (qint64 n = m_indexBase + m_index.size(); n < end; n++)
+        m_index.append(signature(m_pBuffer->at(n - dropped)->getText()));
+
+    if (m_pattern.isEmpty())
+        return;
+    while (!m_hits.isEmpty() && m_hits.constBegin().key() < dropped)
+        m_hits.erase(m_hits.begin());
+    for (qint64 n = qMax(m_searched, dropped); n < end; n++) {
+        if (!m_regex) {
+            const Signature & sig = m_index.at(n - m_indexBase);
+            if ((sig.bits[0] & m_query.bits[0]) != m_query.bits[0]
+                    || (sig.bits[1] & m_query.bits[1]) != m_query.bits[1]
+                    || (sig.bits[2] & m_query.bits[2]) != m_query.bits[2]
+                    || (sig.bits[3] & m_query.bits[3]) != m_query.bits[3])
+                continue;
+        }
+        QVector<QPoint> ranges = match(m_pBuffer->at(n - dropped));
+        if (!ranges.isEmpty())
+            m_hits.insert(n, ranges);
+    }
+    m_searched = end;
+}
+
+QVector<QPoint> BufferSearch::hits(int y)
+{
+    if (m_pattern.isEmpty())
+        return QVector<QPoint>();
+    int top = history();
+    if (y < top)
+        return m_hits.value(m_pBuffer->dropped() + y);
+
+    TextLine * line = m_pBuffer->at(y);
+    if (line == NULL)
+        return QVector<QPoint>();
+    if (m_rows.size() < m_pBuffer->line())
+        m_rows.resize(m_pBuffer->line());
+    Row & row = m_rows[y - top];
+    if (row.line != line || row.revision != line->revision()) {
+        row.line = line;
+        row.revision = line->revision();
+        row.hits = match(line);
+    }
+    return row.hits;
+}
+
+int BufferSearch::findPrev(int y)
+{
+    if (m_pattern.isEmpty())
+        return -1;
+    int top = history();
+    for (int i = qMin(y, m_pBuffer->lines()) - 1; i >= top; i--)
+        if (!hits(i).isEmpty())
+            return i;
+
+    qint64 dropped = m_pBuffer->dropped();
+    QMap<qint64, QVector<QPoint> >::const_iterator it = m_hits.lowerBound(dropped + qMin(y, top));
+    if (it == m_hits.constBegin())
+        return -1;
+    --it;
+    if (it.key() < dropped)
+        return -1;
+    return it.key() - dropped;
+}
+
+QVector<QPoint> BufferSearch::match(TextLine * line)
+{
+    QVector<QPoint> ranges;
+    QString text = line->getText();
+    int pos = 0;
+    int len = 0;
+    while (pos < text.length()) {
+        if (m_regex) {
+            pos = m_re.indexIn(text, pos);
+            len = m_re.matchedLength();
+        } else {
+            pos = text.indexOf(m_pattern, pos, Qt::CaseInsensitive);
+            len = m_pattern.length();
+        }
+        if (pos == -1)
+            break;
+        if (len <= 0) {
+            pos++;
+            continue;
+        }
+        int last = pos + len < text.length() ? line->beginIndex(pos + len) - 1
+                                             : line->getLength() - 1;
+        ranges << QPoint(line->beginIndex(pos), last);
+        pos += len;
+    }
+    return ranges;
+}
+
+} // namespace QTerm
+
+#include <moc_qtermsearch.cpp>
@@ -0,0 +1,85 @@
+#ifndef QTERMSEARCH_H
+#define QTERMSEARCH_H
+
+#include <QtCore/QObject>
+#include <QtCore/QMap>
+#include <QtCore/QPoint>
+#include <QtCore/QRegExp>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+namespace QTerm
+{
+class Buffer;
+class TextLine;
+
+/*
+ * Case-insensitive search over the whole buffer, scrollback included.
+ *
+ * Every history line gets a small signature of its characters and
+ * character pairs when it scrolls off the screen, so a plain search only
+ * looks at the text of lines whose signature covers the pattern's.  Each
+ * QChar counts as one character, which keeps CJK text searchable without
+ * word breaking.  Regular expressions are run on every line.
+ *
+ * History lines never change, their matches are kept by line number and
+ * new history lines are searched as they arrive.  Screen rows are
+ * searched again whenever their revision changes.
+ */
+class BufferSearch : public QObject
+{
+    Q_OBJECT
+public:
+    BufferSearch(Buffer * buffer, QObject * parent = 0);
+    ~BufferSearch();
+
+    // returns the number of matching lines, an empty pattern clears
+    int find(const QString & pattern, bool regex = false);
+    void clear();
+    bool isEmpty() const {
+        return m_pattern.isEmpty();
+    }
+    int count();
+
+    // matched columns on buffer line y, x() is the first and y() the last
+    QVector<QPoint> hits(int y);
+    // the nearest buffer line above y that has a match, -1 if none
+    int findPrev(int y);
+
+public slots:
+    void update();
+
+private:
+    struct Signature {
+        quint64 bits[4];
+    };
+    struct Row {
+        Row() : line(0), revision(0) {}
+        TextLine * line;
+        quint64 revision;
+        QVector<QPoint> hits;
+    };
+
+    static Signature signature(const QString & text);
+    int history();
+    QVector<QPoint> match(TextLine * line);
+
+    Buffer * m_pBuffer;
+
+    // signatures of history lines, m_index[0] is line number m_indexBase
+    QVector<Signature> m_index;
+    qint64 m_indexBase;
+
+    QString m_pattern;
+    bool m_regex;
+    QRegExp m_re;
+    Signature m_query;
+    // history matches by line number, lines below m_searched are done
+    QMap<qint64, QVector<QPoint> > m_hits;
+    qint64 m_searched;
+    QVector<Row> m_rows;
+};
+
+} // namespace QTerm
+
+#endif // QTERMSEARCH_H
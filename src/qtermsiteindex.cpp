@@ -0,0 +1,205 @@
+#include "qtermsiteindex.h"
+
+#include <QtCore/QtAlgorithms>
+#include <QtCore/QUuid>
+#include <QtXml/QDomNodeList>
+
+namespace QTerm
+{
+
+// leads every word so its first letters form trigrams of their own
+static const ushort Mark = 1;
+
+static inline bool isInner(quint64 gram)
+{
+    return (gram >> 32) != Mark && ((gram >> 16) & 0xffff) != Mark;
+}
+
+struct Ranked {
+    int score;
+    int slot;
+    QString name;
+};
+
+static bool rankedLessThan(const Ranked & a, const Ranked & b)
+{
+    if (a.score != b.score)
+        return a.score > b.score;
+    return a.name < b.name;
+}
+
+SiteIndex::SiteIndex()
+    : m_entries(), m_free(), m_slot(), m_postings()
+{
+}
+
+SiteIndex::~SiteIndex()
+{
+}
+
+QVector<quint64> SiteIndex::grams(const QString & text)
+{
+    QVector<quint64> result;
+    int n = text.length();
+    int i = 0;
+    while (i < n) {
+        while (i < n && !text.at(i).isLetterOrNumber())
+            i++;
+        ushort a = Mark;
+        ushort b = Mark;
+        while (i < n && text.at(i).isLetterOrNumber()) {
+            ushort c = text.at(i).unicode();
+            result << ((quint64(a) << 32) | (quint64(b) << 16) | c);
+            a = b;
+            b = c;
+            i++;
+        }
+    }
+    qSort(result);
+    int count = 0;
+    for (int k = 0; k < result.size(); k++)
+        if (count == 0 || result.at(k) != result.at(count - 1))
+            result[count++] = result.at(k);
+    result.resize(count);
+    return result;
+}
+
+void SiteIndex::build(QDomDocument doc)
+{
+    clear();
+    // a site is tagged with every folder a reference to it is in
+    QHash<QString, QStringList> tags;
+    QDomNodeList refList = doc.elementsByTagName("addsite");
+    for (int i = 0; i < refList.count(); i++) {
+        QDomElement ref = refList.at(i).toElement();
+        QStringList & folders = tags[ref.attribute("uuid")];
+        for (QDomElement folder = ref.parentNode().toElement();
+                !folder.isNull() && folder.nodeName() == "folder";
+                folder = folder.parentNode().toElement())
+            folders << folder.attribute("name");
+    }
+    QDomNodeList siteList = doc.elementsByTagName("site");
+    for (int i = 0; i < siteList.count(); i++) {
+        QDomElement site = siteList.at(i).toElement();
+        setSite(site, tags.value(site.attribute("uuid")).join(" "));
+    }
+}
+
+void SiteIndex::clear()
+{
+    m_entries.clear();
+    m_free.clear();
+    m_slot.clear();
+    m_postings.clear();
+}
+
+void SiteIndex::setSite(const QDomElement & site, const QString & tags)
+{
+    QString uuid = site.attribute("uuid");
+    // the default site is a template, not something to connect to
+    if (QUuid(uuid).isNull())
+        return;
+
+    int slot = m_slot.value(uuid, -1);
+    if (slot >= 0) {
+        unlink(slot);
+    } else if (!m_free.isEmpty()) {
+        slot = m_free.takeLast();
+    } else {
+        slot = m_entries.size();
+        m_entries.resize(slot + 1);
+    }
+    m_slot.insert(uuid, slot);
+
+    Entry & entry = m_entries[slot];
+    entry.uuid = uuid;
+    entry.name = site.attribute("name").toCaseFolded();
+    if (!tags.isNull())
+        entry.tags = tags;
+    entry.text = QString("%1\n%2\n%3\n%4").arg(site.attribute("name"))
+                 .arg(site.attribute("addr")).arg(site.attribute("user"))
+                 .arg(entry.tags).toCaseFolded();
+    entry.grams = grams(entry.text);
+    foreach (quint64 gram, entry.grams)
+        m_postings[gram] << slot;
+}
+
+void SiteIndex::removeSite(const QString & uuid)
+{
+    int slot = m_slot.value(uuid, -1);
+    if (slot < 0)
+        return;
+    unlink(slot);
+    m_slot.remove(uuid);
+    m_entries[slot] = Entry();
+    m_free << slot;
+}
+
+void SiteIndex::unlink(int slot)
+{
+    foreach (quint64 gram, m_entries.at(slot).grams) {
+        QHash<quint64, QVector<int> >::iterator it = m_postings.find(gram);
+        if (it == m_postings.end())
+            continue;
+        int pos = it.value().indexOf(slot);
+        if (pos >= 0)
+            it.value().remove(pos);
+        if (it.value().isEmpty())
+            m_postings.erase(it);
+    }
+}
+
+QStringList SiteIndex::search(const QString & query, int limit) const
+{
+    QString folded = query.trimmed().toCaseFolded();
+    QVector<quint64> queryGrams = grams(folded);
+    if (queryGrams.isEmpty())
+        return QStringList();
+
+    // a site needs two fifths of the trigrams, or all of those inside words
+    // when the query starts in the middle of one
+    int n = queryGrams.size();
+    int need = n <= 2 ? n : (2 * n + 4) / 5;
+    int inner = 0;
+    QVector<int> shared(m_entries.size(), 0);
+    QVector<int> sharedInner(m_entries.size(), 0);
+    QVector<int> touched;
+    foreach (quint64 gram, queryGrams) {
+        bool in = isInner(gram);
+        if (in)
+            inner++;
+        QHash<quint64, QVector<int> >::const_iterator it = m_postings.constFind(gram);
+        if (it == m_postings.constEnd())
+            continue;
+        foreach (int slot, it.value()) {
+            if (shared[slot]++ == 0)
+                touched << slot;
+            if (in)
+                sharedInner[slot]++;
+        }
+    }
+
+    QList<Ranked> ranked;
+    foreach (int slot, touched) {
+        if (shared.at(slot) < need && (inner == 0 || sharedInner.at(slot) < inner))
+            continue;
+        const Entry & entry = m_entries.at(slot);
+        Ranked r;
+        r.score = shared.at(slot) * 100 / n;
+        if (entry.text.contains(folded))
+            r.score += 100;
+        if (entry.name.startsWith(folded))
+            r.score += 50;
+        r.slot = slot;
+        r.name = entry.name;
+        ranked << r;
+    }
+    qSort(ranked.begin(), ranked.end(), rankedLessThan);
+
+    QStringList result;
+    for (int i = 0; i < ranked.size() && (limit < 0 || i < limit); i++)
+        result << m_entries.at(ranked.at(i).slot).uuid;
+    return result;
+}
+
+} // namespace QTerm
@@ -0,0 +1,66 @@
+#ifndef QTERMSITEINDEX_H
+#define QTERMSITEINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtXml/QDomDocument>
+#include <QtXml/QDomElement>
+
+namespace QTerm
+{
+
+/*
+ * Finds sites of an address book by name, address, user and the names of
+ * the folders they are in.  Every word is cut into trigrams, led by two
+ * boundary marks so that one or two typed letters match the words they
+ * start.  A query is cut the same way and a site matches when it shares
+ * two fifths of the trigrams, rounded up, so typos and transposed letters
+ * still find it; sites are ranked by the share, then by whole substring
+ * and name prefix hits.
+ *
+ * Sites are added, changed and removed one at a time, nothing is ever
+ * rebuilt behind the caller's back.
+ */
+class SiteIndex
+{
+public:
+    SiteIndex();
+    ~SiteIndex();
+
+    // every site of the document, with folder names as tags
+    void build(QDomDocument doc);
+    void clear();
+    // tags left null keep those the site had
+    void setSite(const QDomElement & site, const QString & tags = QString());
+    void removeSite(const QString & uuid);
+    bool isEmpty() const {
+        return m_slot.isEmpty();
+    }
+
+    // uuids, best match first
+    QStringList search(const QString & query, int limit = 50) const;
+
+private:
+    struct Entry {
+        QString uuid;
+        QString name;       // folded
+        QString tags;
+        QString text;       // folded name, address, user and tags
+        QVector<quint64> grams;
+    };
+
+    static QVector<quint64> grams(const QString & text);
+    void unlink(int slot);
+
+    QVector<Entry> m_entries;
+    QList<int> m_free;
+    QHash<QString, int> m_slot;
+    QHash<quint64, QVector<int> > m_postings;
+};
+
+} // namespace QTerm
+
+#endif // QTERMSITEINDEX_H
@@ -6,6 +6,9 @@
 //Added by qt3to4:
 #include <QByteArray>
 #include <QTcpSocket>
+#include <QHostInfo>
+#include <QDateTime>
+#include <QHash>
 #include <QtGlobal>
 
 #if !defined(Q_OS_BSD4) && !defined(Q_OS_FREEBSD_) \
@@ -36,6 +39,22 @@ parse_http_status_line (const char *line, const char **reason_phrase_ptr);
 
 const char wingate_enter = 'J'&0x1f;
 
+// Addresses looked up for socks proxies, shared by all windows.  QHostInfo
+// does not tell the record's TTL, so entries are kept for a fixed time.
+// Only used on the GUI thread.
+struct CachedHost
+{
+	QList<QHostAddress> addresses;
+	QDateTime expires;
+};
+static const int HostCacheTtl = 300;	// seconds
+
+static QHash<QString, CachedHost> & hostCache()
+{
+	static QHash<QString, CachedHost> cache;
+	return cache;
+}
+
 //==============================================================================
 //SocketPrivate
 //==============================================================================
@@ -43,6 +62,7 @@ SocketPrivate::SocketPrivate(QObject * parent)
 	:QObject(parent)
 {
 	m_socket = new QTcpSocket(this);
+	m_lookupId = -1;
 
 	// proxy related
 	proxy_type = NOPROXY;
@@ -82,6 +102,7 @@ void SocketPrivate::socketConnected()
 	char *proxyauth;
 	char *request;
 	int len=0;
+	quint32 ip;
 	
 	switch( proxy_type )
 	{
@@ -100,8 +121,13 @@ void SocketPrivate::socketConnected()
 		command.resize(9);
 		command[0]='\x04';
 		command[1]='\x01';
-		memcpy(command.data()+2,&addr_host.sin_port,2);
-		memcpy(command.data()+4,&addr_host.sin_addr,4);
+		command[2]=port>>8;
+		command[3]=port&0xff;
+		ip=m_address.toIPv4Address();
+		command[4]=ip>>24;
+		command[5]=(ip>>16)&0xff;
+		command[6]=(ip>>8)&0xff;
+		command[7]=ip&0xff;
 		writeBlock(command);
 		proxy_state = 1;
 		emit SocketState( TSPROXYCONNECTED );
@@ -243,7 +269,6 @@ void SocketPrivate::connectToHost(HostInfo * hostInfo)
 	m_hostInfo = hostInfo;
 	host=m_hostInfo->hostName();
 	port=m_hostInfo->port();
-	addr_host.sin_port=htons(port);
 
 	if( proxy_type == NOPROXY )
 	{
@@ -252,41 +277,64 @@ void SocketPrivate::connectToHost(HostInfo * hostInfo)
 		m_socket->connectToHost(proxy_host, proxy_port);
 	} else
 	{
-		//get ip addr from name
-		struct hostent * hostent;
-	#if defined(_OS_WIN32_) || defined(Q_OS_WIN32)
-		WSADATA wsd;
-		if (WSAStartup(0x202,&wsd) != 0)
-		{
-			emit SocketState(TSEINIWINSOCK);
-			WSACleanup( );
-			return;
-		}
-	#endif
-/*		QHostAddress ha(host);
-		if(ha.isIPv4Address())
-		{
-			hostent = gethostbyaddr( (char *)host, host.length(), AF_INET );
-		}
+		// socks proxies need the address of the host, it is looked up
+		// without blocking and the proxy is contacted once it is known
+		QHash<QString, CachedHost>::const_iterator it = hostCache().constFind(host);
+		if (it != hostCache().constEnd() && it.value().expires > QDateTime::currentDateTime())
+			connectViaProxy(it.value().addresses);
 		else
-*/		{
-			hostent = gethostbyname( host.toLocal8Bit() );
-		}
+			m_lookupId = QHostInfo::lookupHost(host, this, SLOT(hostLookedUp(QHostInfo)));
+	}
+
+}
 
-		if( hostent==NULL )
+void SocketPrivate::hostLookedUp(const QHostInfo & hostInfo)
+{
+	if (hostInfo.lookupId() != m_lookupId)
+		return;
+	m_lookupId = -1;
+	if (hostInfo.error() != QHostInfo::NoError || hostInfo.addresses().isEmpty())
+	{
+		emit SocketState(TSEGETHOSTBYNAME);
+		return;
+	}
+	CachedHost entry;
+	entry.addresses = hostInfo.addresses();
+	entry.expires = QDateTime::currentDateTime().addSecs(HostCacheTtl);
+	hostCache().insert(host, entry);
+	connectViaProxy(entry.addresses);
+}
+
+// socks4 only knows IPv4, socks5 takes IPv6 too but IPv4 is preferred
+void SocketPrivate::connectViaProxy(const QList<QHostAddress> & addresses)
+{
+	m_address = QHostAddress();
+	foreach (const QHostAddress & address, addresses)
+	{
+		if (address.protocol() == QAbstractSocket::IPv4Protocol)
 		{
-			emit SocketState(TSEGETHOSTBYNAME);
-			return;
+			m_address = address;
+			break;
 		}
-		//now only ipv4 support
-		memcpy(&addr_host.sin_addr,hostent->h_addr,4);
-		m_socket->connectToHost( proxy_host, proxy_port );
+		if (proxy_type == SOCKS5 && m_address.isNull()
+				&& address.protocol() == QAbstractSocket::IPv6Protocol)
+			m_address = address;
 	}
-
+	if (m_address.isNull())
+	{
+		emit SocketState(TSEGETHOSTBYNAME);
+		return;
+	}
+	m_socket->connectToHost( proxy_host, proxy_port );
 }
 
 void SocketPrivate::close()
 {
+	if (m_lookupId != -1)
+	{
+		QHostInfo::abortHostLookup(m_lookupId);
+		m_lookupId = -1;
+	}
 	m_socket->close();
 }
 
@@ -311,13 +359,27 @@ unsigned long SocketPrivate::bytesAvailable()
  */
 void SocketPrivate::socks5_connect()
 {
-	QByteArray command (10,0);
+	QByteArray command (4,0);
 	command[0]='\x05';
 	command[1]='\x01';
 	command[2]='\x00';
-	command[3]='\x01';
-	memcpy( command.data()+4, &addr_host.sin_addr,4 );
-	memcpy( command.data()+8, &addr_host.sin_port,2 ); 
+	if( m_address.protocol()==QAbstractSocket::IPv6Protocol )
+	{
+		Q_IPV6ADDR ip6 = m_address.toIPv6Address();
+		command[3]='\x04';
+		command.append( (const char *)&ip6, 16 );
+	}
+	else
+	{
+		quint32 ip = m_address.toIPv4Address();
+		command[3]='\x01';
+		command.append( char(ip>>24) );
+		command.append( char((ip>>16)&0xff) );
+		command.append( char((ip>>8)&0xff) );
+		command.append( char(ip&0xff) );
+	}
+	command.append( char(port>>8) );
+	command.append( char(port&0xff) );
 	writeBlock( command );
 }
 /*------------------------------------------------------------------------
@@ -397,7 +459,8 @@ void SocketPrivate::socks5_reply( const QByteArray& from_socket, int nread )
 	else if( proxy_state==3)	//Socks5 Proxy Replay 3
 	{
 		proxy_state=0;
-		if( nread!=10 )
+		// 10 bytes for an IPv4 bound address, 22 for IPv6
+		if( nread<10 )
 		{
 			emit SocketState( TSPROXYERROR );
 			return;
@@ -5,6 +5,7 @@
 #include <QtGlobal>
 #include <QtCore/QObject>
 #include <QtNetwork/QTcpSocket>
+#include <QtNetwork/QHostAddress>
 // different 
 #if defined(Q_OS_WIN32) || defined(_OS_WIN32_)
 	#include <winsock2.h>
@@ -21,6 +22,8 @@
 	#include <arpa/inet.h>
 #endif
 
+class QHostInfo;
+
 namespace QTerm
 {
 class HostInfo;
@@ -55,8 +58,10 @@ signals:
 protected slots:
 	void socketConnected();
 	void socketReadyRead();	
+	void hostLookedUp(const QHostInfo &);
 	
 protected:
+	void connectViaProxy(const QList<QHostAddress> &);
 	// socks5 function
 	void socks5_connect();
 	void socks5_auth();
@@ -74,7 +79,9 @@ private:
 	int			proxy_state;
 	bool		bauth;
 
-	struct sockaddr_in  addr_host;
+	// the host as the socks proxy is told about it
+	QHostAddress m_address;
+	int m_lookupId;
 
 	HostInfo * m_hostInfo;
 	QTcpSocket *m_socket;
@@ -11,6 +11,7 @@ AUTHOR:        kingson fiasco
 
 #include "qterm.h"
 #include "qtermtextline.h"
+#include "qtermglobal.h"
 
 #include <QtCore/QRegExp>
 #include <QtCore/QString>
@@ -19,12 +20,16 @@ AUTHOR:        kingson fiasco
 
 namespace QTerm
 {
+quint64 TextLine::s_revision = 0;
+
 TextLine::TextLine(QObject * parent)
         : QObject(parent), m_text(), m_color(), m_attr()
 {
     m_bChanged = true;
     m_start = -1;
     m_end = -1;
+    m_shownConversion = Global::No_Conversion;
+    m_revision = ++s_revision;
     reset();
 }
 
@@ -217,6 +222,21 @@ QString TextLine::getText(int index, int len)
     return str;
 }
 
+QString TextLine::getShownText(int index, int len, int conversion)
+{
+    if (conversion == Global::No_Conversion)
+        return getText(index, len);
+    if (m_text.isEmpty()||len == 0) {
+        return QString();
+    }
+    if (m_shownConversion != conversion) {
+        m_shown = m_text.string();
+        Global::instance()->convert(m_shown.data(), m_shown.size(), (Global::Conversion)conversion);
+        m_shownConversion = conversion;
+    }
+    return m_text.mid(m_shown, index, len);
+}
+
 QString TextLine::getAttrText(int index, int len, const QString & escape)
 {
     QString str;
@@ -288,6 +308,9 @@ inline void TextLine::reset()
     m_curColor = NO_COLOR;
     m_curAttr = NO_ATTR;
 
+    m_shown = QString();
+    m_shownConversion = Global::No_Conversion;
+
 
 }
 bool TextLine::hasBlink()
@@ -318,6 +341,9 @@ bool TextLine::isChanged(int &start, int &end)
 
 void TextLine::setChanged(int start, int end)
 {
+    m_shownConversion = Global::No_Conversion;
+    m_revision = ++s_revision;
+
     if (start == -1 && end == -1) {
         m_bChanged = true;
         m_start = start;
@@ -366,6 +392,7 @@ void TextLine::setAttr(short attr, int index)
         tmpAttr = NO_ATTR;
     m_color[index] = tmpColor;
     m_attr[index] = tmpAttr;
+    setChanged(index, index + 1);
 }
 
 } // namespace QTerm
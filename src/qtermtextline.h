@@ -25,6 +25,12 @@ public slots:
 
     bool isChanged(int &start, int &end);
 
+    // changes on every setChanged(), unique across all lines, so
+    // (line, revision) identifies a line's content for caches
+    quint64 revision() const {
+        return m_revision;
+    }
+
     QByteArray getColor() {
         return m_color;
     }
@@ -41,6 +47,10 @@ public slots:
 
     QString getText(int index = -1, int len = -1);
 
+    // text as displayed with the given Global::Conversion, converted
+    // once and kept until the line changes
+    QString getShownText(int index, int len, int conversion);
+
     void insertText(const QString & str, short attr = -1, int index = -1);
 
     void deleteText(int index = -1, int len = -1);
@@ -68,6 +78,11 @@ protected:
     bool m_bChanged;
     bool m_bBlink;
 
+    QString m_shown;
+    int m_shownConversion;
+    quint64 m_revision;
+    static quint64 s_revision;
+
     int m_start, m_end;
 };
 
@@ -0,0 +1,134 @@
+#include "qtermtrigger.h"
+#include "qtermbuffer.h"
+#include "qtermtextline.h"
+
+#include <QtCore/QStringList>
+
+namespace QTerm
+{
+
+// lines remembered beyond the screen before the old ones are forgotten
+static const int CacheSize = 1024;
+
+Trigger::Trigger()
+    : m_rules(), m_matcher(), m_checked()
+{
+}
+
+Trigger::~Trigger()
+{
+}
+
+QList<Trigger::Rule> Trigger::parse(const QString & text)
+{
+    QList<Rule> rules;
+    foreach (QString line, text.split('\n')) {
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        int arrow = line.lastIndexOf("=>");
+        if (arrow <= 0) {
+            qDebug("trigger without an action: %s", qPrintable(line));
+            continue;
+        }
+        Rule rule;
+        rule.pattern = line.left(arrow).trimmed();
+        rule.regex = rule.pattern.startsWith("re:");
+        if (rule.regex)
+            rule.pattern = rule.pattern.mid(3);
+
+        QString action = line.mid(arrow + 2).trimmed();
+        int colon = action.indexOf(':');
+        QString name = (colon == -1 ? action : action.left(colon)).trimmed().toLower();
+        rule.argument = colon == -1 ? QString() : action.mid(colon + 1).trimmed();
+        if (name == "send")
+            rule.action = Send;
+        else if (name == "script" && !rule.argument.isEmpty())
+            rule.action = Script;
+        else if (name == "notify")
+            rule.action = Notify;
+        else {
+            qDebug("unknown trigger action: %s", qPrintable(action));
+            continue;
+        }
+        if (!rule.pattern.isEmpty())
+            rules << rule;
+    }
+    return rules;
+}
+
+void Trigger::setRules(const QList<Rule> & rules)
+{
+    clear();
+    foreach (const Rule & rule, rules)
+        addRule(rule);
+}
+
+bool Trigger::addRule(const Rule & rule)
+{
+    // the index of the rule is what the matcher reports
+    if (!m_matcher.addRule(rule.pattern, m_rules.size(), rule.regex)) {
+        qDebug("invalid trigger pattern: %s", qPrintable(rule.pattern));
+        return false;
+    }
+    m_rules << rule;
+    m_checked.clear();
+    return true;
+}
+
+void Trigger::clear()
+{
+    m_rules.clear();
+    m_matcher.clear();
+    m_checked.clear();
+}
+
+QList<Trigger::Match> Trigger::check(Buffer * buffer)
+{
+    QList<Match> matches;
+    if (isEmpty())
+        return matches;
+
+    for (int y = 0; y < buffer->line(); y++) {
+        TextLine * line = buffer->screen(y);
+        if (line == NULL)
+            continue;
+        QHash<TextLine *, quint64>::iterator it = m_checked.find(line);
+        if (it != m_checked.end() && it.value() == line->revision())
+            continue;
+        if (it == m_checked.end())
+            m_checked.insert(line, line->revision());
+        else
+            it.value() = line->revision();
+
+        QVector<Highlighter::Span> spans = m_matcher.spans(line);
+        QList<int> fired;
+        foreach (const Highlighter::Span & span, spans) {
+            if (fired.contains(span.attr))
+                continue;
+            fired << span.attr;
+            Match match;
+            match.rule = span.attr;
+            match.text = line->getText();
+            matches << match;
+        }
+    }
+
+    // keep what is on the screen, so it is not matched again
+    if (m_checked.size() > CacheSize) {
+        m_checked.clear();
+        markChecked(buffer);
+    }
+    return matches;
+}
+
+void Trigger::markChecked(Buffer * buffer)
+{
+    for (int y = 0; y < buffer->line(); y++) {
+        TextLine * line = buffer->screen(y);
+        if (line != NULL)
+            m_checked.insert(line, line->revision());
+    }
+}
+
+} // namespace QTerm
@@ -0,0 +1,75 @@
+#ifndef QTERMTRIGGER_H
+#define QTERMTRIGGER_H
+
+#include "qtermhighlighter.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+namespace QTerm
+{
+class Buffer;
+class TextLine;
+
+/*
+ * Rules of a site acting on text as it shows up on the screen, one per
+ * line of the "triggers" parameter:
+ *
+ *     [re:]pattern => send:text | script:function | notify:text
+ *
+ * Lines starting with # are comments.  Patterns ignore case and are all
+ * matched by one Highlighter, so a screen line is scanned once however
+ * many rules there are, and only when its revision has changed; a rule
+ * fires at most once for each revision of a line it matches.
+ */
+class Trigger
+{
+public:
+    enum Action {
+        Send,       // write the text, escapes as in prelogin
+        Script,     // call QTerm.function with the line
+        Notify,     // show the text, or the line if there is none
+        Login       // the auto-login of the site
+    };
+    struct Rule {
+        QString pattern;
+        bool regex;
+        Action action;
+        QString argument;
+    };
+    struct Match {
+        int rule;
+        QString text;   // the line matched
+    };
+
+    Trigger();
+    ~Trigger();
+
+    // rules that can not be parsed are skipped
+    static QList<Rule> parse(const QString & text);
+    void setRules(const QList<Rule> & rules);
+    bool addRule(const Rule & rule);
+    void clear();
+    bool isEmpty() const {
+        return m_rules.isEmpty();
+    }
+    const Rule & rule(int index) const {
+        return m_rules.at(index);
+    }
+
+    // rules matching the lines of the screen changed since the last call
+    QList<Match> check(Buffer * buffer);
+    // take the screen as checked, so rules replaced on a live window do
+    // not fire on what it already shows
+    void markChecked(Buffer * buffer);
+
+private:
+    QList<Rule> m_rules;
+    Highlighter m_matcher;
+    QHash<TextLine *, quint64> m_checked;
+};
+
+} // namespace QTerm
+
+#endif // QTERMTRIGGER_H
@@ -21,6 +21,13 @@ AUTHOR:        kingson fiasco
 #include "addrdialog.h"
 #include "qtermconfig.h"
 #include "qtermbbs.h"
+#include "qtermarticle.h"
+#include "qtermsearch.h"
+#include "qtermhighlighter.h"
+#include "qtermtrigger.h"
+#ifdef PYTHON_ENABLED
+#include "qtermpython.h"
+#endif
 #include "msgdialog.h"
 #include "qtermtextline.h"
 #include "articledialog.h"
@@ -94,6 +101,7 @@ namespace QTerm
 
 // script thread
 DAThread::DAThread(Window *win)
+    : m_wanted(true), m_stop(false)
 {
     pWin = win;
 }
@@ -103,65 +111,60 @@ DAThread::~DAThread()
 
 }
 
+// The buffer is only read here on the GUI thread, the worker gets a copy.
+// Pages drawn while the worker is not waiting for one are ignored.
+void DAThread::addPage()
+{
+    QStringList page;
+    for (int i = 0; i < pWin->m_pBuffer->line(); i++)
+        page << ArticleCapture::stripRight(pWin->m_pBuffer->screen(i)->getText());
+
+    QMutexLocker locker(&mutex);
+    if (!m_wanted)
+        return;
+    m_wanted = false;
+    m_page = page;
+    m_pageReady.wakeOne();
+}
+
+void DAThread::stop()
+{
+    QMutexLocker locker(&mutex);
+    m_stop = true;
+    m_pageReady.wakeOne();
+}
+
 void DAThread::run()
 {
+    ArticleCapture article;
     mutex.lock();
-    QStringList strList;
-    while (1) {
-        // check it there is duplicated string
-        // it starts from the end in the range of one screen height
-        // so this is a non-greedy match
-        QString strTemp = pWin->m_pBuffer->screen(0)->getText().replace(QRegExp("\\s+$"),"");
-        int i = 0;
-        int start = 0;
-        QStringList::Iterator it = strList.end();
-        while (it != strList.begin() && i < pWin->m_pBuffer->line() - 1) {
-//   for(QStringList::Iterator it=strList.end();
-//    it!=strList.begin(), i < pWin->m_pBuffer->line()-1; // not exceeeding the last screen
-//    --it, i++)
-            --it;
-            i++;
-            if (*it != strTemp)
-                continue;
-            QStringList::Iterator it2 = it;
-            bool dup = true;
-            // match more to see if its duplicated
-            for (int j = 0; j <= i && it2 != strList.end(); j++, it2++) {
-                QString str1 = pWin->m_pBuffer->screen(j)->getText().replace(QRegExp("\\s+$"),"");
-                if (*it2 != str1) {
-                    dup = false;
-                    break;
-                }
-            }
-            if (dup) {
-                // set the start point
-                start = i + 1;
+    while (!m_stop) {
+        if (m_page.isEmpty()) {
+            if (!m_pageReady.wait(&mutex, 10000)) { // timeout
+                emit done(DAE_TIMEOUT);
                 break;
             }
+            continue;
         }
-        // add new lines
-        for (i = start;i < pWin->m_pBuffer->line() - 1;i++)
-            strList += pWin->m_pBuffer->screen(i)->getText().replace(QRegExp("\\s+$"),"");
+        QStringList page = m_page;
+        m_page.clear();
+        mutex.unlock();
+
+        // the last line is the status bar
+        QString bottom = page.takeLast();
+        article.addPage(page);
 
         // the end of article
-        if (pWin->m_pBuffer->screen(
-                    pWin->m_pBuffer->line() - 1)->getText().indexOf("%") == -1)
-            break;
-        // continue
-        pWin->m_pTelnet->write(" ", 1);
-        if (!pWin->m_wcWaiting.wait(&mutex, 10000)) { // timeout
-            //qApp->postEvent(pWin, new QCustomEvent(DAE_TIMEOUT));
-            emit done(DAE_TIMEOUT);
-            break;
+        if (bottom.indexOf("%") == -1) {
+            strArticle = article.finish();
+            emit done(DAE_FINISH);
+            return;
         }
+        // continue
+        mutex.lock();
+        m_wanted = true;
+        emit nextPage();
     }
-#if defined(_OS_WIN32_) || defined(Q_OS_WIN32)
-    strArticle = strList.join("\r\n");
-#else
-    strArticle = strList.join("\n");
-#endif
-    //qApp->postEvent(pWin, new QCustomEvent(DAE_FINISH));
-    emit done(DAE_FINISH);
     mutex.unlock();
 }
 
@@ -248,12 +251,12 @@ Window::Window(Frame * frame, Param param, const QString &uuid, QWidget * parent
     m_strUuid = uuid;
     m_hostInfo = NULL;
     m_translator = NULL;
-    QString pathLib = Global::instance()->pathLib();
     setMouseTracking(true);
 
 #ifdef SCRIPT_ENABLED
     m_scriptEngine = NULL;
     m_scriptHelper = NULL;
+    m_bSharedScript = false;
 #ifdef SCRIPTTOOLS_ENABLED
     m_scriptDebugger = new QScriptEngineDebugger;
 #endif // SCRIPTTOOLS_ENABLED
@@ -290,10 +293,14 @@ Window::Window(Frame * frame, Param param, const QString &uuid, QWidget * parent
 
     m_pDecode = new Decode(m_pBuffer, m_codec);
     m_pBBS   = new BBS(m_pBuffer);
+    m_pSearch = new BufferSearch(m_pBuffer);
+    m_pHighlighter = new Highlighter;
+    m_pTrigger = new Trigger;
+    loadTriggers();
+    m_nFindLine = -1;
     m_pScreen = new Screen(this, m_pBuffer, &m_param, m_pBBS);
 
-    m_pIPLocation = new IPLocation(pathLib);
-    m_bCheckIP = m_pIPLocation->haveFile();
+    m_bCheckIP = IPLocation::instance()->haveFile();
     m_pSound = NULL;
 
     setWidget(m_pScreen);
@@ -379,9 +386,9 @@ Window::Window(Frame * frame, Param param, const QString &uuid, QWidget * parent
     cursor[8] = Qt::IBeamCursor;
     cursor[9] = Qt::ArrowCursor;
 
-    // the system wide script
-    m_bPythonScriptLoaded = false;
-
+#ifdef PYTHON_ENABLED
+    m_pPython = NULL;
+#endif
     initScript();
 
     loadKeyboardTranslator(param.m_mapParam["keyboardprofile"].toString());
@@ -392,8 +399,21 @@ Window::Window(Frame * frame, Param param, const QString &uuid, QWidget * parent
 //destructor
 Window::~Window()
 {
+    if (m_pDAThread != 0) {
+        m_pDAThread->stop();
+        m_pDAThread->wait();
+        delete m_pDAThread;
+    }
+#ifdef PYTHON_ENABLED
+    // not waited for, it touches nothing of ours once stopped
+    if (m_pPython != NULL)
+        m_pPython->stop();
+#endif
     delete m_pTelnet;
     delete m_pBBS;
+    delete m_pSearch;
+    delete m_pHighlighter;
+    delete m_pTrigger;
     delete m_pDecode;
     delete m_pBuffer;
     delete m_pZmodem;
@@ -407,7 +427,6 @@ Window::~Window()
     delete m_pUrl;
     delete m_pScreen;
     delete m_reconnectTimer;
-    delete m_pIPLocation;
     delete m_pSound;
     delete m_hostInfo;
 #ifdef SCRIPTTOOLS_ENABLED
@@ -449,15 +468,10 @@ void Window::idleProcess()
     m_bIdling = true;
     // system script can handle that
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("antiIdle");
-        if (func.isFunction()) {
-            func.call();
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("antiIdle is not a function");
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::AntiIdle)) {
+        m_scriptHelper->callHook(ScriptHelper::AntiIdle);
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -471,6 +485,27 @@ void Window::idleProcess()
     m_pTelnet->write(cstr, length);
 }
 
+void Window::scriptReply()
+{
+#ifdef SCRIPT_ENABLED
+    if (m_scriptEngine == NULL || !m_scriptHelper->hasHook(ScriptHelper::AutoReply))
+        return;
+    m_scriptHelper->setAccepted(false);
+    m_scriptHelper->callHook(ScriptHelper::AutoReply);
+    if (!m_scriptHelper->accepted()) {
+        // TODO: save messages
+        if (m_bIdling)
+            replyMessage();
+        else
+            m_replyTimer->start(m_param.m_mapParam["maxidle"].toInt()*1000 / 2);
+    }
+    if (m_scriptEngine->hasUncaughtException()) {
+        QScriptValue exception = m_scriptEngine->uncaughtException();
+        qDebug() << "Exception: " << exception.toString();
+    }
+#endif
+}
+
 void Window::replyProcess()
 {
     // if AutoReply still enabled, then autoreply
@@ -496,15 +531,10 @@ void Window::leaveEvent(QEvent *)
 void Window::mouseDoubleClickEvent(QMouseEvent * me)
 {
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onMouseEvent");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << 3 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onMouseEvent is not a function");
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnMouseEvent)) {
+        m_scriptHelper->callHook(ScriptHelper::OnMouseEvent, QScriptValueList() << 3 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -531,15 +561,10 @@ void Window::mousePressEvent(QMouseEvent * me)
     }
 
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onMouseEvent");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << 0 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onMouseEvent is not a function");
+    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnMouseEvent)) {
+        m_scriptHelper->callHook(ScriptHelper::OnMouseEvent, QScriptValueList() << 0 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -602,15 +627,10 @@ void Window::mouseMoveEvent(QMouseEvent * me)
     }
 
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onMouseEvent");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << 2 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onMouseEvent is not a function");
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnMouseEvent)) {
+        m_scriptHelper->callHook(ScriptHelper::OnMouseEvent, QScriptValueList() << 2 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -675,15 +695,10 @@ void Window::mouseReleaseEvent(QMouseEvent * me)
 
 
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onMouseEvent");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << 1 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onMouseEvent is not a function");
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnMouseEvent)) {
+        m_scriptHelper->callHook(ScriptHelper::OnMouseEvent, QScriptValueList() << 1 << (int) me->button() << (int) me->buttons() << (int) me->modifiers() << me->x() << me->y());
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -763,16 +778,11 @@ void Window::mouseReleaseEvent(QMouseEvent * me)
 void Window::wheelEvent(QWheelEvent *we)
 {
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnWheelEvent)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onWheelEvent");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << we->delta() << (int) we->buttons() << (int) we->modifiers() << (int) we->orientation() << we->x() << we->y() );
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onWheelEvent is not a function");
+        m_scriptHelper->callHook(ScriptHelper::OnWheelEvent, QScriptValueList() << we->delta() << (int) we->buttons() << (int) we->modifiers() << (int) we->orientation() << we->x() << we->y());
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -796,16 +806,11 @@ void Window::wheelEvent(QWheelEvent *we)
 void Window::keyPressEvent(QKeyEvent * e)
 {
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnKeyPressEvent)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onKeyPressEvent");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << e->key() << (int) e->modifiers() << e->text());
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onMouseEvent is not a function");
+        m_scriptHelper->callHook(ScriptHelper::OnKeyPressEvent, QScriptValueList() << e->key() << (int) e->modifiers() << e->text());
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -961,16 +966,11 @@ void Window::ZmodemState(int type, int value, const QString& msg)
 {
     QString status = m_codec->toUnicode(msg.toLatin1());
 #ifdef SCRIPT_ENABLED
-	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
+	if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnZmodemState)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onZmodemState");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << type << value << status);
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onZmodemState is not a function");
+        m_scriptHelper->callHook(ScriptHelper::OnZmodemState, QScriptValueList() << type << value << status);
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -1049,16 +1049,11 @@ void Window::ZmodemState(int type, int value, const QString& msg)
 void Window::TelnetState(int state)
 {
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
+    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnTelnetState)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onTelnetState");
-        if (func.isFunction()) {
-            func.call(QScriptValue(), QScriptValueList() << state);
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onTelnetState is not a function");
+        m_scriptHelper->callHook(ScriptHelper::OnTelnetState, QScriptValueList() << state);
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -1172,6 +1167,39 @@ void Window::on_actionPaste_triggered()
     pasteHelper(true);
 }
 
+// Find the same pattern again to step to the previous match
+void Window::on_actionFind_triggered()
+{
+    bool ok;
+    QString pattern = QInputDialog::getText(this, tr("Find"),
+                      tr("Text to find, or /pattern/ for a regular expression:"),
+                      QLineEdit::Normal, m_strFind, &ok);
+    if (!ok)
+        return;
+
+    if (pattern != m_strFind || m_pSearch->isEmpty()) {
+        m_strFind = pattern;
+        m_nFindLine = m_pBuffer->lines();
+        bool regex = pattern.length() > 2 && pattern.startsWith('/') && pattern.endsWith('/');
+        if (m_pSearch->find(regex ? pattern.mid(1, pattern.length() - 2) : pattern, regex) == 0) {
+            if (!pattern.isEmpty())
+                m_pScreen->osd()->display(tr("Not found"));
+            on_actionRefresh_triggered();
+            return;
+        }
+    }
+
+    int line = m_pSearch->findPrev(m_nFindLine);
+    if (line == -1)
+        line = m_pSearch->findPrev(m_pBuffer->lines());
+    if (line == -1)
+        return;
+    m_nFindLine = line;
+    int start = qBound(0, line - m_pBuffer->line() / 2, m_pBuffer->lines() - m_pBuffer->line());
+    m_pScreen->scrollLine(start - m_pScreen->m_nStart);
+    on_actionRefresh_triggered();
+}
+
 void Window::pasteHelper(bool clip)
 {
     if (!m_bConnected)
@@ -1227,17 +1255,12 @@ void Window::on_actionCopy_Article_triggered()
         return;
 
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
+    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnCopyArticle)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onCopyArticle");
-        if (func.isFunction()) {
-            QScriptValue text = func.call();
-            if (m_scriptHelper->accepted()) {
-                showArticle(text.toString());
-                return;
-            }
-        } else {
-            qDebug("onCopyArticle is not a function");
+        QScriptValue text = m_scriptHelper->callHook(ScriptHelper::OnCopyArticle);
+        if (m_scriptHelper->accepted()) {
+            showArticle(text.toString());
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -1246,8 +1269,15 @@ void Window::on_actionCopy_Article_triggered()
     }
 #endif
 
+    if (m_pDAThread != 0) {
+        if (m_pDAThread->isRunning())
+            return;
+        delete m_pDAThread;
+    }
     m_pDAThread = new DAThread(this);
     connect(m_pDAThread, SIGNAL(done(int)), this, SLOT(jobDone(int)));
+    connect(m_pDAThread, SIGNAL(nextPage()), this, SLOT(articleNextPage()));
+    m_pDAThread->addPage();
     m_pDAThread->start();
 
 }
@@ -1277,6 +1307,7 @@ void Window::on_actionCurrent_Session_Setting_triggered()
             Global::instance()->saveAddressXml(doc);
         }
         loadKeyboardTranslator(m_param.m_mapParam["keyboardprofile"].toString());
+        loadTriggers();
     } else {
         m_param = backup;
     }
@@ -1306,7 +1337,7 @@ void Window::showIP()
     }
     QString country, city;
     QString url = m_pBBS->getIP();
-    if (m_pIPLocation->getLocation(url, country, city)) {
+    if (IPLocation::instance()->getLocation(url, country, city)) {
         m_pScreen->osd()->display((country + city), PageViewMessage::Info, 0, PageViewMessage::IP);
     }
 }
@@ -1374,10 +1405,25 @@ void Window::on_actionSymbols_triggered(const QVariant& data)
 	m_pTelnet->write(text,text.length());
 }
 
+#ifdef SCRIPTTOOLS_ENABLED
+// attaching takes the engine from any other debugger, so the windows
+// sharing one engine share its debugger too
+static QScriptEngineDebugger * sharedDebugger()
+{
+    static QScriptEngineDebugger * debugger = NULL;
+    if (debugger == NULL) {
+        debugger = new QScriptEngineDebugger(qApp);
+        debugger->attachTo(ScriptHelper::sharedEngine());
+    }
+    return debugger;
+}
+#endif
+
 void Window::on_actionDebug_Console_triggered()
 {
 #ifdef SCRIPTTOOLS_ENABLED
-    m_scriptDebugger->action(QScriptEngineDebugger::InterruptAction)->trigger();
+    QScriptEngineDebugger * debugger = m_bSharedScript ? sharedDebugger() : m_scriptDebugger;
+    debugger->action(QScriptEngineDebugger::InterruptAction)->trigger();
 #else
 	QMessageBox::information(this, "QTerm",
                              tr("You need to enable the script engine debugger to use this feature. \
@@ -1395,6 +1441,10 @@ void Window::on_actionStop_triggered()
 #ifdef SCRIPT_ENABLED
     m_scriptEngine->abortEvaluation();
 #endif
+#ifdef PYTHON_ENABLED
+    if (m_pPython != NULL)
+        m_pPython->stop();
+#endif
 }
 
 void Window::on_actionReload_Script_triggered()
@@ -1490,6 +1540,56 @@ void Window::doAutoLogin()
     m_bDoingLogin = false;
 }
 
+void Window::loadTriggers()
+{
+    m_pTrigger->setRules(Trigger::parse(m_param.m_mapParam["triggers"].toString()));
+    // the login prompt, acted on only while logging in
+    if (m_param.m_mapParam["autologin"].toBool()) {
+        Trigger::Rule rule;
+        rule.pattern = "guest.*new|new.*guest";
+        rule.regex = true;
+        rule.action = Trigger::Login;
+        m_pTrigger->addRule(rule);
+    }
+    // new rules act on what comes next, not on the screen shown
+    m_pTrigger->markChecked(m_pBuffer);
+}
+
+void Window::runTriggers()
+{
+    foreach (const Trigger::Match & match, m_pTrigger->check(m_pBuffer)) {
+        const Trigger::Rule & rule = m_pTrigger->rule(match.rule);
+        switch (rule.action) {
+        case Trigger::Send:
+            if (m_bConnected) {
+                int length;
+                QByteArray cstr = parseString(rule.argument.toLocal8Bit(), &length);
+                m_pTelnet->write(cstr, length);
+            }
+            break;
+        case Trigger::Script:
+#ifdef SCRIPT_ENABLED
+            if (m_scriptEngine != NULL) {
+                m_scriptHelper->callFunction(rule.argument, QScriptValueList() << match.text);
+                if (m_scriptEngine->hasUncaughtException()) {
+                    QScriptValue exception = m_scriptEngine->uncaughtException();
+                    qDebug() << "Exception: " << exception.toString();
+                }
+            }
+#endif
+            break;
+        case Trigger::Notify:
+            showMessage(m_param.m_mapParam["name"].toString(),
+                        rule.argument.isEmpty() ? match.text.trimmed() : rule.argument, -1);
+            break;
+        case Trigger::Login:
+            if (m_bDoingLogin)
+                doAutoLogin();
+            break;
+        }
+    }
+}
+
 void Window::reconnectProcess()
 {
 	int nRetry = m_param.m_mapParam["retrytimes"].toInt();
@@ -1518,6 +1618,11 @@ void Window::jobDone(int e)
     }
 }
 
+void Window::articleNextPage()
+{
+    m_pTelnet->write(" ", 1);
+}
+
 void Window::showArticle(const QString text)
 {
     if (text.isEmpty()) {
@@ -1631,43 +1736,99 @@ void Window::initScript()
 #ifdef SCRIPTTOOLS_ENABLED
     m_scriptDebugger->detach();
 #endif
-    delete m_scriptEngine;
+    if (!m_bSharedScript)
+        delete m_scriptEngine;
     delete m_scriptHelper;
-    m_scriptEngine = new QScriptEngine(this);
-    m_scriptHelper = new ScriptHelper(this, m_scriptEngine);
+    // highlight rules belong to the script being replaced
+    m_pHighlighter->clear();
+    m_bSharedScript = Global::instance()->m_pref.bSharedScript;
+    if (m_bSharedScript)
+        m_scriptEngine = ScriptHelper::sharedEngine();
+    else
+        m_scriptEngine = new QScriptEngine(this);
+    m_scriptHelper = new ScriptHelper(this, m_scriptEngine, m_bSharedScript);
 
 #ifdef SCRIPTTOOLS_ENABLED
-    m_scriptDebugger->attachTo(m_scriptEngine);
+    if (!m_bSharedScript)
+        m_scriptDebugger->attachTo(m_scriptEngine);
 #endif
 
     QScriptValue scriptHelper = m_scriptEngine->newQObject(m_scriptHelper);
-    m_scriptEngine->globalObject().setProperty("QTerm", scriptHelper);
+    m_scriptHelper->scope().setProperty("QTerm", scriptHelper);
 	if (!m_param.m_mapParam["loadscript"].toBool())
         return;
     m_pBBS->setScript(m_scriptEngine, m_scriptHelper);
     m_scriptHelper->loadScript(m_param.m_mapParam["scriptfile"].toString());
-    QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("init");
+    QScriptValue func = m_scriptHelper->scope().property("QTerm").property("init");
     if (!func.isFunction()) {
         qDebug() << "init is not a function";
     }
     func.call();
+    // init may still have added or replaced handlers
+    m_scriptHelper->resolveHooks();
 #endif // SCRIPT_ENABLED
 }
 
 void Window::runScript(const QString & filename)
 {
-#ifdef SCRIPT_ENABLED
     QString file = filename;
     if (file.isEmpty()){
         // get the previous dir
+#ifdef PYTHON_ENABLED
+        file= Global::instance()->getOpenFileName("Script Files (*.js *.py *.txt)", this);
+#else
         file= Global::instance()->getOpenFileName("Script Files (*.js *.txt)", this);
+#endif
     }
     if (file.isEmpty())
         return;
 
+#ifdef PYTHON_ENABLED
+    if (file.endsWith(".py", Qt::CaseInsensitive)) {
+        runPythonScript(file);
+        return;
+    }
+#endif
+#ifdef SCRIPT_ENABLED
     m_scriptHelper->loadScriptFile(file);
 #endif
 }
+
+#ifdef PYTHON_ENABLED
+void Window::runPythonScript(const QString & filename)
+{
+    if (m_pPython != NULL) {
+        osdMessage(tr("A Python script is still running"), PageViewMessage::Warning, 2000);
+        return;
+    }
+    if (!PythonThread::initialize()) {
+        osdMessage(tr("Cannot start Python"), PageViewMessage::Error, 2000);
+        return;
+    }
+    m_pPython = new PythonThread(this, filename);
+    connect(m_pPython, SIGNAL(stringSent(const QString &)), this, SLOT(inputHandle(const QString &)));
+    connect(m_pPython, SIGNAL(parsedStringSent(const QString &)), this, SLOT(sendParsedString(const QString &)));
+    connect(m_pPython, SIGNAL(reconnectRequested()), this, SLOT(reconnect()));
+    connect(m_pPython, SIGNAL(disconnectRequested()), this, SLOT(on_actionDisconnect_triggered()));
+    connect(m_pPython, SIGNAL(error(const QString &)), this, SLOT(pythonError(const QString &)));
+    connect(m_pPython, SIGNAL(finished()), this, SLOT(pythonFinished()));
+    connect(m_pPython, SIGNAL(finished()), m_pPython, SLOT(deleteLater()));
+    m_pPython->updateScreen(false);
+    m_pPython->start();
+}
+
+void Window::pythonError(const QString & message)
+{
+    qDebug() << message;
+    osdMessage(message, PageViewMessage::Error, 0);
+}
+
+void Window::pythonFinished()
+{
+    if (sender() == m_pPython)
+        m_pPython = NULL;
+}
+#endif // PYTHON_ENABLED
 void Window::inputHandle(const QString & text)
 {
     if (text.length() > 0) {
@@ -1756,16 +1917,11 @@ QMenu * Window::urlMenu()
 void Window::updateWindow()
 {
 #ifdef SCRIPT_ENABLED
-    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
+    if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::OnNewData)) {
         m_scriptHelper->setAccepted(false);
-        QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("onNewData");
-        if (func.isFunction()) {
-            func.call();
-            if (m_scriptHelper->accepted()) {
-                return;
-            }
-        } else {
-            qDebug("onNewData is not a function");
+        m_scriptHelper->callHook(ScriptHelper::OnNewData);
+        if (m_scriptHelper->accepted()) {
+            return;
         }
         if (m_scriptEngine->hasUncaughtException()) {
             QScriptValue exception = m_scriptEngine->uncaughtException();
@@ -1774,28 +1930,20 @@ void Window::updateWindow()
     }
 #endif
 
-        if (m_bDoingLogin) {
-            int n = m_pBuffer->caret().y();
-            for (int y = n - 5;y < n + 5;y++) {
-                y = qMax(0, y);
-                TextLine *pTextLine = m_pBuffer->screen(y);
-                if (pTextLine == NULL)
-                    continue;
-                QString str = pTextLine->getText();
-                if (str.indexOf("guest") != -1 && str.indexOf("new") != -1) {
-                    doAutoLogin();
-                    break;
-                }
-            }
-        }
+        runTriggers();
         // page complete when caret at the right corner
         // this works for most but not for all
         TextLine * pTextLine = m_pBuffer->screen(m_pBuffer->line() - 1);
 
         QString strText = pTextLine->getText().replace(QRegExp("\\s+$"),"");
-        if (m_pBuffer->caret().y() == m_pBuffer->line() - 1 &&
-                m_pBuffer->caret().x() >= strText.length() - 1)
-            m_wcWaiting.wakeAll();
+        bool pageComplete = m_pBuffer->caret().y() == m_pBuffer->line() - 1 &&
+                m_pBuffer->caret().x() >= strText.length() - 1;
+        if (pageComplete && m_pDAThread != 0 && m_pDAThread->isRunning())
+            m_pDAThread->addPage();
+#ifdef PYTHON_ENABLED
+        if (m_pPython != NULL)
+            m_pPython->updateScreen(pageComplete);
+#endif
 
         //QToolTip::remove(this, m_pScreen->mapToRect(m_rcUrl));
 
@@ -1835,28 +1983,9 @@ void Window::updateWindow()
             }
         if (m_bAutoReply) {
 #ifdef SCRIPT_ENABLED
-            if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool()) {
-                m_scriptHelper->setAccepted(false);
-                QScriptValue func = m_scriptEngine->globalObject().property("QTerm").property("autoReply");
-                if (func.isFunction()) {
-                    func.call();
-                    if (m_scriptHelper->accepted()) {
-                        return;
-                    } else {
-                        // TODO: save messages
-                        if (m_bIdling)
-                            replyMessage();
-                        else
-                            m_replyTimer->start(m_param.m_mapParam["maxidle"].toInt()*1000 / 2);
-                    }
-                } else {
-                    qDebug("autoReply is not a function");
-                }
-                if (m_scriptEngine->hasUncaughtException()) {
-                    QScriptValue exception = m_scriptEngine->uncaughtException();
-                    qDebug() << "Exception: " << exception.toString();
-                }
-            }
+            // after the screen is updated, the script may take its time
+            if (m_scriptEngine != NULL && m_param.m_mapParam["loadscript"].toBool() && m_scriptHelper->hasHook(ScriptHelper::AutoReply))
+                QTimer::singleShot(0, this, SLOT(scriptReply()));
 #endif
         }
         //m_pFrame->buzz();
@@ -1919,7 +2048,7 @@ void Window :: groupActions()
         << "actionPrint" << "actionPrint_Preview"
 		<< "actionRefresh"
 		<< "actionPallete" << "actionUnderline" << "actionBlink" << "actionSymbols"
-        << "actionCopy" << "actionPaste" 
+        << "actionCopy" << "actionPaste" << "actionFind"
         << "actionAuto_Copy" << "actionCopy_w_Color"
 		<< "actionRectangle_Selection" << "actionPaste_w_Wordwrap"
 		<< "actionAnti_Idle" << "actionAuto_Reply"
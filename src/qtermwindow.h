@@ -23,6 +23,7 @@
 #include <QCloseEvent>
 #include <QWaitCondition>
 #include <QMutex>
+#include <QStringList>
 
 class QProgressDialog;
 class QTextCodec;
@@ -42,6 +43,12 @@ class Decode;
 class Buffer;
 class Frame;
 class BBS;
+class BufferSearch;
+class Highlighter;
+class Trigger;
+#ifdef PYTHON_ENABLED
+class PythonThread;
+#endif
 class popWidget;
 class Zmodem;
 class Window;
@@ -63,12 +70,20 @@ public:
     ~DAThread();
 
     virtual void run();
+    // called on the GUI thread when a page has been drawn
+    void addPage();
+    void stop();
     QString strArticle;
     QMutex mutex;
 signals:
     void done(int);
+    void nextPage();
 private:
     Window *pWin;
+    QWaitCondition m_pageReady;
+    QStringList m_page;
+    bool m_wanted;
+    bool m_stop;
 };
 
 class Window: public WindowBase
@@ -96,6 +111,7 @@ public slots:
 	// Edit
     void on_actionCopy_triggered();
 	void on_actionPaste_triggered();
+	void on_actionFind_triggered();
 	void on_actionRectangle_Selection_toggled(bool rect) { m_bRectCopy = rect; }
 	void on_actionCopy_w_Color_toggled(bool color) { m_bColorCopy = color; }
 	void on_actionAuto_Copy_toggled(bool automatic) { m_bAutoCopy = automatic; }
@@ -159,6 +175,11 @@ protected slots:
     // timer
     void idleProcess();
     void replyProcess();
+    void scriptReply();
+#ifdef PYTHON_ENABLED
+    void pythonError(const QString &);
+    void pythonFinished();
+#endif
     void updateWindow();
 
     //http menu
@@ -173,6 +194,7 @@ protected slots:
     // decode
 	void setMouseMode(bool on ) { m_bMouseX11 = on; }
     void jobDone(int);
+    void articleNextPage();
     void showArticle(const QString text);
     void updateHostKey(const QString & hostKey);
 
@@ -189,6 +211,11 @@ protected:
     void reconnectProcess();
     void connectionClosed();
     void doAutoLogin();
+    void loadTriggers();
+#ifdef PYTHON_ENABLED
+    void runPythonScript(const QString & filename);
+#endif
+    void runTriggers();
     void replyMessage();
 
     void pasteHelper(bool);
@@ -215,6 +242,9 @@ protected:
 
     bool m_bMessage;
     QString m_strMessage;
+    // last Find pattern and the line it was found on
+    QString m_strFind;
+    int m_nFindLine;
 
     // mouse select
     QPoint m_ptSelStart, m_ptSelEnd;
@@ -241,11 +271,10 @@ protected:
     // download article thread
     DAThread *m_pDAThread;
 
-    // python
-#ifdef HAVE_PYTHON
-    PyObject *pModule, *pDict;
+#ifdef PYTHON_ENABLED
+    // the python script running, deletes itself when done
+    PythonThread * m_pPython;
 #endif
-    bool m_bPythonScriptLoaded;
 
     // play sound
     Sound * m_pSound;
@@ -258,7 +287,6 @@ protected:
 
     //IP location
     QString location;
-    IPLocation * m_pIPLocation;
 
     //osd
     PageViewMessage * m_pMessage;
@@ -270,6 +298,8 @@ protected:
 #ifdef SCRIPT_ENABLED
     QScriptEngine * m_scriptEngine;
     ScriptHelper * m_scriptHelper;
+    // m_scriptEngine is ScriptHelper::sharedEngine(), not ours
+    bool m_bSharedScript;
 #ifdef SCRIPTTOOLS_ENABLED
     QScriptEngineDebugger * m_scriptDebugger;
 #endif
@@ -280,6 +310,9 @@ public:
     Telnet * m_pTelnet;
     Param m_param;
     BBS * m_pBBS;
+    BufferSearch * m_pSearch;
+    Highlighter * m_pHighlighter;
+    Trigger * m_pTrigger;
     HostInfo * m_hostInfo;
     // menu and toolbar state
     bool m_bColorCopy;
@@ -293,9 +326,6 @@ public:
     bool m_bReconnect;
     friend class Screen;
 
-    QString m_strPythonError;
-
-    QWaitCondition m_wcWaiting;
 
 };
 
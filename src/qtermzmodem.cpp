@@ -1,4 +1,6 @@
 #include "qtermzmodem.h"
+#include "zmodemio.h"
+#include "zmodemcrc.h"
 #include "qtermtelnet.h"
 #include "qtermframe.h"
 #include "qterm.h"
@@ -17,149 +19,6 @@ namespace QTerm
 #include <sys/time.h>
 #endif
 
-/*
- *  Crc calculation stuff
- */
-
-/* crctab calculated by Mark G. Mendel, Network Systems Corporation */
-unsigned short crctab[256] = {
-    0x0000,  0x1021,  0x2042,  0x3063,  0x4084,  0x50a5,  0x60c6,  0x70e7,
-    0x8108,  0x9129,  0xa14a,  0xb16b,  0xc18c,  0xd1ad,  0xe1ce,  0xf1ef,
-    0x1231,  0x0210,  0x3273,  0x2252,  0x52b5,  0x4294,  0x72f7,  0x62d6,
-    0x9339,  0x8318,  0xb37b,  0xa35a,  0xd3bd,  0xc39c,  0xf3ff,  0xe3de,
-    0x2462,  0x3443,  0x0420,  0x1401,  0x64e6,  0x74c7,  0x44a4,  0x5485,
-    0xa56a,  0xb54b,  0x8528,  0x9509,  0xe5ee,  0xf5cf,  0xc5ac,  0xd58d,
-    0x3653,  0x2672,  0x1611,  0x0630,  0x76d7,  0x66f6,  0x5695,  0x46b4,
-    0xb75b,  0xa77a,  0x9719,  0x8738,  0xf7df,  0xe7fe,  0xd79d,  0xc7bc,
-    0x48c4,  0x58e5,  0x6886,  0x78a7,  0x0840,  0x1861,  0x2802,  0x3823,
-    0xc9cc,  0xd9ed,  0xe98e,  0xf9af,  0x8948,  0x9969,  0xa90a,  0xb92b,
-    0x5af5,  0x4ad4,  0x7ab7,  0x6a96,  0x1a71,  0x0a50,  0x3a33,  0x2a12,
-    0xdbfd,  0xcbdc,  0xfbbf,  0xeb9e,  0x9b79,  0x8b58,  0xbb3b,  0xab1a,
-    0x6ca6,  0x7c87,  0x4ce4,  0x5cc5,  0x2c22,  0x3c03,  0x0c60,  0x1c41,
-    0xedae,  0xfd8f,  0xcdec,  0xddcd,  0xad2a,  0xbd0b,  0x8d68,  0x9d49,
-    0x7e97,  0x6eb6,  0x5ed5,  0x4ef4,  0x3e13,  0x2e32,  0x1e51,  0x0e70,
-    0xff9f,  0xefbe,  0xdfdd,  0xcffc,  0xbf1b,  0xaf3a,  0x9f59,  0x8f78,
-    0x9188,  0x81a9,  0xb1ca,  0xa1eb,  0xd10c,  0xc12d,  0xf14e,  0xe16f,
-    0x1080,  0x00a1,  0x30c2,  0x20e3,  0x5004,  0x4025,  0x7046,  0x6067,
-    0x83b9,  0x9398,  0xa3fb,  0xb3da,  0xc33d,  0xd31c,  0xe37f,  0xf35e,
-    0x02b1,  0x1290,  0x22f3,  0x32d2,  0x4235,  0x5214,  0x6277,  0x7256,
-    0xb5ea,  0xa5cb,  0x95a8,  0x8589,  0xf56e,  0xe54f,  0xd52c,  0xc50d,
-    0x34e2,  0x24c3,  0x14a0,  0x0481,  0x7466,  0x6447,  0x5424,  0x4405,
-    0xa7db,  0xb7fa,  0x8799,  0x97b8,  0xe75f,  0xf77e,  0xc71d,  0xd73c,
-    0x26d3,  0x36f2,  0x0691,  0x16b0,  0x6657,  0x7676,  0x4615,  0x5634,
-    0xd94c,  0xc96d,  0xf90e,  0xe92f,  0x99c8,  0x89e9,  0xb98a,  0xa9ab,
-    0x5844,  0x4865,  0x7806,  0x6827,  0x18c0,  0x08e1,  0x3882,  0x28a3,
-    0xcb7d,  0xdb5c,  0xeb3f,  0xfb1e,  0x8bf9,  0x9bd8,  0xabbb,  0xbb9a,
-    0x4a75,  0x5a54,  0x6a37,  0x7a16,  0x0af1,  0x1ad0,  0x2ab3,  0x3a92,
-    0xfd2e,  0xed0f,  0xdd6c,  0xcd4d,  0xbdaa,  0xad8b,  0x9de8,  0x8dc9,
-    0x7c26,  0x6c07,  0x5c64,  0x4c45,  0x3ca2,  0x2c83,  0x1ce0,  0x0cc1,
-    0xef1f,  0xff3e,  0xcf5d,  0xdf7c,  0xaf9b,  0xbfba,  0x8fd9,  0x9ff8,
-    0x6e17,  0x7e36,  0x4e55,  0x5e74,  0x2e93,  0x3eb2,  0x0ed1,  0x1ef0
-};
-
-/*
- * updcrc macro derived from article Copyright (C) 1986 Stephen Satchell.
- *  NOTE: First argument must be in range 0 to 255.
- *        Second argument is referenced twice.
- *
- * Programmers may incorporate any or all code into their programs,
- * giving proper credit within the source. Publication of the
- * source routines is permitted so long as proper credit is given
- * to Stephen Satchell, Satchell Evaluations and Chuck Forsberg,
- * Omen Technology.
- */
-
-#define updcrc(cp, crc) ( crctab[((crc >> 8) & 255)] ^ (crc << 8) ^ cp)
-
-/*
- * Copyright (C) 1986 Gary S. Brown.  You may use this program, or
- * code or tables extracted from it, as desired without restriction.
- */
-
-/* First, the polynomial itself and its table of feedback terms.  The  */
-/* polynomial is                                                       */
-/* X^32+X^26+X^23+X^22+X^16+X^12+X^11+X^10+X^8+X^7+X^5+X^4+X^2+X^1+X^0 */
-/* Note that we take it "backwards" and put the highest-order term in  */
-/* the lowest-order bit.  The X^32 term is "implied"; the LSB is the   */
-/* X^31 term, etc.  The X^0 term (usually shown as "+1") results in    */
-/* the MSB being 1.                                                    */
-
-/* Note that the usual hardware shift register implementation, which   */
-/* is what we're using (we're merely optimizing it by doing eight-bit  */
-/* chunks at a time) shifts bits into the lowest-order term.  In our   */
-/* implementation, that means shifting towards the right.  Why do we   */
-/* do it this way?  Because the calculated CRC must be transmitted in  */
-/* order from highest-order term to lowest-order term.  UARTs transmit */
-/* characters in order from LSB to MSB.  By storing the CRC this way,  */
-/* we hand it to the UART in the order low-byte to high-byte; the UART */
-/* sends each low-bit to hight-bit; and the result is transmission bit */
-/* by bit from highest- to lowest-order term without requiring any bit */
-/* shuffling on our part.  Reception works similarly.                  */
-
-/* The feedback terms table consists of 256, 32-bit entries.  Notes:   */
-/*                                                                     */
-/*     The table can be generated at runtime if desired; code to do so */
-/*     is shown later.  It might not be obvious, but the feedback      */
-/*     terms simply represent the results of eight shift/xor opera-    */
-/*     tions for all combinations of data and CRC register values.     */
-/*                                                                     */
-/*     The values must be right-shifted by eight bits by the "updcrc"  */
-/*     logic; the shift must be unsigned (bring in zeroes).  On some   */
-/*     hardware you could probably optimize the shift in assembler by  */
-/*     using byte-swap instructions.                                   */
-
-unsigned long cr3tab[] = { /* CRC polynomial 0xedb88320 */
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
-    0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-    0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
-    0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
-    0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
-    0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
-    0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-    0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
-    0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
-    0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-    0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
-    0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
-    0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
-    0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
-    0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-    0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
-    0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
-    0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-    0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
-    0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
-    0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
-    0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
-    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-    0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
-    0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
-    0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-    0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
-    0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
-    0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
-};
-
-#define UPDC32(b, c) (cr3tab[((int)c ^ b) & 0xff] ^ ((c >> 8) & 0x00FFFFFF))
-
-#define updcrc(cp, crc) ( crctab[((crc >> 8) & 255)] ^ (crc << 8) ^ cp)
-
-
-
 #if 1
 StateTable Zmodem::RStartOps[] =  {
     {ZSINIT, &Zmodem::GotSinit, 0, 1, RSinitWait}, /* SINIT, wait for attn str */
@@ -451,6 +310,13 @@ Zmodem::Zmodem(QObject * parent, QObject *netinterface, QTextCodec * codec, int
     zmodemTimer = new QTimer(this);
     connect(zmodemTimer, SIGNAL(timeout()), this, SLOT(ZmodemTimeout()));
 
+    m_io = new ZmodemIO(this);
+    connect(m_io, SIGNAL(dataReady()), this, SLOT(fileDataReady()));
+    connect(m_io, SIGNAL(crcReady(ulong)), this, SLOT(fileCrcReady(ulong)));
+    m_dataPending = false;
+
+    m_journal = new Config(Global::instance()->pathCfg() + "zmodem.cfg");
+
 #ifdef QTERM_DEBUG
     zmodemlogfile = fopen("zmodem.log", "w+");
     fprintf(zmodemlogfile, "%s", "\n================================\n");
@@ -464,6 +330,7 @@ Zmodem::Zmodem(QObject * parent, QObject *netinterface, QTextCodec * codec, int
     info.attn = NULL ;
     info.bufsize = 0 ; /* full streaming */
     info.buffer = NULL;
+    info.file = NULL;
 
     zerrno = 0;
     lastPullByte = 0;
@@ -475,6 +342,8 @@ Zmodem::Zmodem(QObject * parent, QObject *netinterface, QTextCodec * codec, int
 
 Zmodem::~Zmodem()
 {
+    closePartial(&info);
+    delete m_journal;
 }
 
 int Zmodem::ZmodemTInit(ZModem *info)
@@ -496,14 +365,17 @@ int Zmodem::ZmodemTInit(ZModem *info)
     info->interrupt = 0 ;
     info->waitflag = 0 ;
 
-// if( info->packetsize <= 0 )
-    info->packetsize = 8096 ;
+    /* start small, SendMoreFileData() grows it up to what GotRinit()
+     * found the receiver can take */
+    info->packetsize = 1024 ;
+    info->maxPacket = 1024 ;
+    info->cleanCount = 0 ;
     info->windowsize = 0;
-    /* we won't be receiving much data, pick a reasonable buffer
-     * size (largest packet will do)
+    /* the buffer holds one escaped subpacket, every byte may take two
+     * plus the trailing crc
      */
 
-    i = info->packetsize * 2 ;
+    i = MaxPacket * 2 + 16 ;
 
     if (info->buffer != NULL) {
         free(info->buffer) ;
@@ -573,6 +445,9 @@ int Zmodem::ZmodemTFile(char *file, char *rfile, uint f0, uint f1, uint f2, uint
         }
     }
 
+    if (info->Protocol == XMODEM || info->Protocol == YMODEM)
+        m_io->startRead(info->file, 0) ;
+
     if (info->Protocol == XMODEM)
         return YSendData(info) ;
 
@@ -628,6 +503,8 @@ int Zmodem::ZmodemAbort(ZModem *info)
 
 int Zmodem::ZmodemRInit(ZModem *info)
 {
+    closePartial(info) ;
+
     info->packetCount = 0 ;
     info->offset = 0 ;
     info->errCount = 0 ;
@@ -645,7 +522,9 @@ int Zmodem::ZmodemRInit(ZModem *info)
         info->buffer = NULL ;
     }
 
-    info->buffer = (uchar *)malloc(1024) ;
+    /* room for the largest ZedZap subpacket, or a Ymodem 1K block
+     * with its header and crc */
+    info->buffer = (uchar *)malloc(MaxPacket + 16) ;
 
     info->state = RStart ;
     info->timeoutCount = 0 ;
@@ -677,7 +556,18 @@ int Zmodem::ZmodemRcv(uchar *str, int len, ZModem *info)
 
     info->rcvlen = len ;
 
-    while (--info->rcvlen >= 0) {
+    while (info->rcvlen > 0) {
+        /* plain subpacket data is taken a run at a time, only escapes,
+         * flow control and frame ends go through the state machine */
+        if (info->InputState == Indata && !info->escape && info->crcCount == 0 &&
+                (info->DataType == ZBIN || info->DataType == ZBIN32)) {
+            int n = DataBlock(str, info->rcvlen, info) ;
+            str += n ;
+            if ((info->rcvlen -= n) <= 0)
+                break ;
+        }
+
+        --info->rcvlen ;
         c = *str++ ;
 
         if (c == CAN) {
@@ -910,6 +800,7 @@ ulong Zmodem::FileCrc(char *name)
 {
     ulong crc ;
     FILE *ifile = fopen(name, "rb") ;
+    uchar buf[65536] ;
     int i ;
 
     if (ifile == NULL)  /* shouldn't happen, since we did access(2) */
@@ -917,11 +808,11 @@ ulong Zmodem::FileCrc(char *name)
 
     crc = 0xffffffff ;
 
-    while ((i = fgetc(ifile)) != EOF)
-        crc = UPDC32(i, crc) ;
+    while ((i = fread(buf, 1, sizeof(buf), ifile)) > 0)
+        crc = updcrc32(crc, buf, i) ;
 
     fclose(ifile) ;
-    return ~crc ;
+    return ~crc & 0xffffffff ;
 }
 
 
@@ -1030,17 +921,34 @@ void Zmodem::ZStatus(int type, int value, const char * status)
     }
 }
 
+/* Open the file being received.  An existing file is appended to when
+ * the sender asks to resume, or when the journal shows it is the partial
+ * copy of this same remote file; every byte written was crc checked,
+ * so its size is a safe ZRPOS offset.
+ */
 FILE * Zmodem::ZOpenFile(char *name, ulong crc, ZModem *info)
 {
-    //to be complete
     FILE *rval;
     int apnd = 0;
     QString str = Global::instance()->m_pref.strZmPath + m_codec->toUnicode(name);
+    QString key = str.toUtf8().toHex();
+    QString entry = QString("%1 %2").arg(info->len).arg(info->date);
+
+    if (QFile::exists(str))
+        apnd = info->f0 == ZCRESUM ||
+               m_journal->getItemValue("partial", key).toString() == entry;
     rval = fopen(str.toLocal8Bit(), apnd ? "ab" : "wb") ;
 
-    if (rval == NULL)
+    if (rval == NULL) {
         perror(name) ;
+        return NULL ;
+    }
+    fseek(rval, 0, SEEK_END) ;
+    m_io->startWrite(rval) ;
 
+    m_journalKey = key ;
+    m_journal->setItemValue("partial", key, entry) ;
+    m_journal->save() ;
     return rval ;
 }
 
@@ -1141,10 +1049,9 @@ int Zmodem::ZXmitHdrBin32(int type, uchar data[4], ZModem *info)
     *ptr++ = ZDLE ;
     *ptr++ = ZBIN32 ;
     ptr = putZdle(ptr, type, info) ; crc = UPDC32(type, 0xffffffffL) ;
-    for (len = 4; --len >= 0; ++data) {
+    crc = updcrc32(crc, data, 4) ;
+    for (len = 4; --len >= 0; ++data)
         ptr = putZdle(ptr, *data, info) ;
-        crc = UPDC32(*data, crc) ;
-    }
     crc = ~crc ;
     for (len = 4; --len >= 0; crc >>= 8)
         ptr = putZdle(ptr, crc & 0xff, info) ;
@@ -1304,6 +1211,44 @@ int Zmodem::FinishChar(char c, register ZModem *info)
 
 
 
+/* Consume the leading run of str that DataChar() would simply append to
+ * the buffer, return its length.  Stops at ZDLE (which is also CAN),
+ * XON/XOFF and the telnet doubled bytes DataChar() drops.
+ */
+int Zmodem::DataBlock(uchar *str, int len, register ZModem *info)
+{
+    uchar prev = lastPullByte ;
+    int n ;
+
+    for (n = 0; n < len; ++n) {
+        uchar c = str[n] ;
+        if (c == ZDLE || c == XON || c == XOFF)
+            break ;
+        if (connectionType == 0 &&
+                ((prev == 0x0d && c == 0x00) || (prev == 0xff && c == 0xff)))
+            break ;
+        prev = c ;
+    }
+    /* leave an overlong subpacket to DataChar() */
+    if (n > MaxPacket - info->chrCount) {
+        n = MaxPacket - info->chrCount ;
+        prev = n > 0 ? str[n - 1] : lastPullByte ;
+    }
+    if (n <= 0)
+        return 0 ;
+
+    memcpy(info->buffer + info->chrCount, str, n) ;
+    info->chrCount += n ;
+    if (info->DataType == ZBIN)
+        info->crc = updcrc16(info->crc, str, n) ;
+    else
+        info->crc = updcrc32(info->crc, str, n) ;
+    lastPullByte = prev ;
+    info->canCount = 0 ;
+    return n ;
+}
+
+
 int Zmodem::DataChar(uchar c, register ZModem *info)
 {
     if (c == ZDLE) {
@@ -1342,15 +1287,20 @@ int Zmodem::DataChar(uchar c, register ZModem *info)
 
     lastPullByte = c;
 
+    /* no sender has a reason to exceed this, it is line noise that
+     * lost the frame end, have the data resent */
+    if (info->crcCount == 0 && info->chrCount >= MaxPacket)
+        return ZDataReceived(info, 0) ;
+
     switch (info->DataType) {
         /* TODO: are hex data packets ever used? */
 
     case ZBIN:
-        qDebug("we got zbin: %04x", info->crc);
         info->crc = updcrc(c, info->crc) ;
         if (info->crcCount == 0)
             info->buffer[info->chrCount++] = c ;
         else if (--info->crcCount == 0) {
+            qDebug("we got zbin: %04lx", info->crc & 0xffff);
             return ZDataReceived(info, (info->crc&0xffff) == 0) ;
         }
         break ;
@@ -1551,7 +1501,7 @@ int Zmodem::YsendChar(char c,  ZModem *info)
         case 'G':
             info->chrCount = 0 ;
             if (info->PacketType == 'G') { /* send it all at once */
-                while (info->state == YTData)
+                while (info->state == YTData && !m_dataPending)
                     if ((err = YSendData(info)))
                         return err ;
                 return 0 ;
@@ -1568,7 +1518,8 @@ int Zmodem::YsendChar(char c,  ZModem *info)
             if (info->Protocol == YMODEM) {
                 ZStatus(DataErr, ++info->errCount, NULL) ;
                 info->state = YTFile ;
-                rewind(info->file) ;
+                info->fileEof = 0 ;
+                m_io->startRead(info->file, 0) ;
                 return YSendFilename(info) ;
             }
             /* else XModem, treat it like a NAK */
@@ -1885,6 +1836,9 @@ int Zmodem::SendMoreFileData(ZModem *info)
     int err ;
     int len ;  /* max # chars to send this packet */
     long pending ; /* # of characters sent but not acknowledged */
+    int waitflag = info->waitflag ;
+
+    m_dataPending = false ;
 
     /* ZCRCE: CRC next, frame ends, header follows
      * ZCRCG: CRC next, frame continues nonstop
@@ -1963,47 +1917,68 @@ int Zmodem::SendMoreFileData(ZModem *info)
     {
         int crc32 = info->crc32 ;
         int c = 0, c2, atSign = 0 ;
+        int eof = 0 ;
         ulong crc ;
         uchar *ptr = info->buffer ;
 
         crc = crc32 ? 0xffffffff : 0 ;
 
-        /* read characters from file and put into buffer until buffer is
-         * full or file is exhausted
+        /* take characters from the read-ahead buffer and put into buffer
+         * until buffer is full or file is exhausted
          */
 
+        while (len > 0) {
+            const uchar *data ;
+            int avail = m_io->peek(&data), n ;
+            if (avail < 0)  /* not read yet, send what we have */
+                break ;
+            if (avail == 0) {
+                eof = 1 ;
+                break ;
+            }
+
+            for (n = 0; len > 0 && n < avail; ++n) {
+                c = data[n] ;
+
+                /* zmodem protocol requires that CAN(ZDLE), DLE, XON, XOFF and
+                 * a CR following '@' be escaped.  In addition, I escape '^]'
+                 * to protect telnet, "<CR>~." to protect rlogin, and ESC for good
+                 * measure.
+                 */
+                c2 = c & 0177 ;
+                if (c == ZDLE || c2 == 020 || c2 == 021 || c2 == 023 ||
+                        c2 == 0177  ||  c2 == '\r'  ||  c2 == '\n'  ||  c2 == 033  ||
+                        c2 == 035  || (c2 < 040 && info->escCtrl)) {
+                    *ptr++ = ZDLE ;
+                    if (c == 0177)
+                        *ptr = ZRUB0 ;
+                    else if (c == 0377)
+                        *ptr = ZRUB1 ;
+                    else
+                        *ptr = c ^ 0100 ;
+                    len -= 2 ;
+                } else {
+                    *ptr = c ;
+                    --len ;
+                }
+                ++ptr ;
+
+                atSign = c2 == '@' ;
+            }
 
-        while (len > 0  && (c = getc(info->file)) != EOF) {
             if (!crc32)
-                crc = updcrc(c, crc) ;
+                crc = updcrc16(crc, data, n) ;
             else
-                crc = UPDC32(c, crc) ;
-
-            /* zmodem protocol requires that CAN(ZDLE), DLE, XON, XOFF and
-             * a CR following '@' be escaped.  In addition, I escape '^]'
-             * to protect telnet, "<CR>~." to protect rlogin, and ESC for good
-             * measure.
-             */
-            c2 = c & 0177 ;
-            if (c == ZDLE || c2 == 020 || c2 == 021 || c2 == 023 ||
-                    c2 == 0177  ||  c2 == '\r'  ||  c2 == '\n'  ||  c2 == 033  ||
-                    c2 == 035  || (c2 < 040 && info->escCtrl)) {
-                *ptr++ = ZDLE ;
-                if (c == 0177)
-                    *ptr = ZRUB0 ;
-                else if (c == 0377)
-                    *ptr = ZRUB1 ;
-                else
-                    *ptr = c ^ 0100 ;
-                len -= 2 ;
-            } else {
-                *ptr = c ;
-                --len ;
-            }
-            ++ptr ;
+                crc = updcrc32(crc, data, n) ;
+            m_io->consume(n) ;
+            info->offset += n ;
+        }
 
-            atSign = c2 == '@' ;
-            ++info->offset ;
+        if (ptr == info->buffer && !eof) {
+            /* nothing to send until fileDataReady() */
+            m_dataPending = true ;
+            info->waitflag = waitflag ;
+            return 0 ;
         }
 
         /* if we've reached file end, a ZEOF header will follow.  If
@@ -2011,7 +1986,7 @@ int Zmodem::SendMoreFileData(ZModem *info)
          * with ZCRCE and append the ZEOF header.  If there isn't room,
          * we'll have to do a ZCRCW
          */
-        if ((info->fileEof = (c == EOF))) {
+        if ((info->fileEof = eof)) {
             if (qfull  || (info->bufsize != 0 && len < 24))
                 type = ZCRCW ;
             else
@@ -2043,6 +2018,15 @@ int Zmodem::SendMoreFileData(ZModem *info)
     if ((err = ZXmitStr(info->buffer, len, info)))
         return err ;
 
+    /* the link has been clean for a while, go back to larger subpackets
+     * and, after an earlier backoff, to streaming without ZACKs */
+    if (++info->cleanCount >= CleanPackets) {
+        info->cleanCount = 0 ;
+        if (info->packetsize < info->maxPacket)
+            info->packetsize *= 2 ;
+        info->Streaming = info->peerStreaming ;
+    }
+
 #ifdef COMMENT
     if ((err = ZXmitData(ZBIN, len, uchar(type), info->buffer, info)))
         return err ;
@@ -2104,17 +2088,23 @@ int Zmodem::dataSetup(register ZModem *info)
     return 0 ;
 }
 
-int Zmodem::ZWriteFile(uchar *buffer, int len, FILE *file, ZModem *)
+int Zmodem::ZWriteFile(uchar *buffer, int len, FILE *, ZModem *)
 {
-
-    return fwrite(buffer, 1, len, file) == len ? 0 : ZmErrSys ;;
+    /* queued for the I/O thread, errors surface on a later call */
+    if (m_io->write(buffer, len) != 0) {
+        zerrno = m_io->error() ;
+        return ZmErrSys ;
+    }
+    return 0 ;
 }
 
 int Zmodem::ZCloseFile(ZModem *info)
 {
-    //to be completed
+    int err = m_io->finishWrite() ;
+    if (err != 0)
+        zerrno = m_io->error() ;
     fclose(info->file) ;
-    return 0;
+    return err != 0 ? ZmErrSys : 0 ;
 }
 
 void Zmodem::ZFlowControl(int onoff, ZModem *info)
@@ -2191,6 +2181,9 @@ int Zmodem::GotEof(ZModem *info)
     /* TODO: if we can't close the file, send a ZFERR */
 
     ZCloseFile(info) ; info->file = NULL ;
+    m_journal->deleteItem("partial", m_journalKey) ;
+    m_journal->save() ;
+    m_journalKey.clear() ;
     ZStatus(FileEnd, 0, info->filename) ;
     if (info->filename != NULL) {
         free(info->filename) ;
@@ -2223,15 +2216,29 @@ int Zmodem::requestFile(ZModem *info, ulong crc)
         ZStatus(FileSkip, 0, info->filename) ;
         return ZXmitHdrHex(ZSKIP, zeros, info) ;
     } else {
+        info->offset = ftell(info->file) ;
         zmodemlog("requestFile[%s]: send ZRPOS(%ld)\n",
                   sname(info), info->offset) ;
-        info->offset = info->f0 == ZCRESUM ? ftell(info->file) : 0 ;
         info->state = RFile ;
         ZStatus(FileBegin, info->len, info->filename) ;
         return ZXmitHdrHex(ZRPOS, ZEnc4(info->offset), info) ;
     }
 }
 
+/* The transfer stopped before ZEOF.  Flush what was verified and leave
+ * the journal entry so the next attempt appends to it. */
+void Zmodem::closePartial(ZModem *info)
+{
+    if (m_journalKey.isEmpty())
+        return ;
+    if (info->file != NULL) {
+        m_io->finishWrite() ;
+        fclose(info->file) ;
+        info->file = NULL ;
+    }
+    m_journalKey.clear() ;
+}
+
 void Zmodem::parseFileName(ZModem *info, char *fileinfo)
 {
     char *ptr ;
@@ -2342,9 +2349,7 @@ int Zmodem::acceptPacket(ZModem *info)
 
 int Zmodem::calcCrc(uchar *str, int len)
 {
-    int crc = 0 ;
-    while (--len >= 0)
-        crc = updcrc(*str++, crc) ;
+    uint crc = updcrc16(0, str, len) ;
     crc = updcrc(0, crc) ; crc = updcrc(0, crc) ;
     return crc & 0xffff ;
 }
@@ -2370,15 +2375,13 @@ int Zmodem::ZXmitData(int format, int len, uchar term, uchar *data, ZModem *info
 
     zmodemlog("ZXmiteData: fmt=%c, len=%d, term=%c\n", format, len, term) ;
 
-    crc = (format == ZBIN) ? 0 : 0xffffffff ;
+    if (format == ZBIN)
+        crc = updcrc16(0, data, len) ;
+    else
+        crc = updcrc32(0xffffffff, data, len) ;
 
-    while (--len >= 0) {
-        if (format == ZBIN)
-            crc = updcrc(*data, crc) ;
-        else
-            crc = UPDC32(*data, crc) ;
+    while (--len >= 0)
         ptr = putZdle(ptr, *data++, info) ;
-    }
 
     *ptr++ = ZDLE ;
     if (format == ZBIN)
@@ -2421,8 +2424,7 @@ int Zmodem::YXmitData(uchar *buffer, int len, ZModem *info)
         trail[0] = crc % 256 ;
         return ZXmitStr(trail, 1, info) ;
     } else {
-        for (i = 0; i < len; ++i)
-            crc = updcrc(buffer[i], crc) ;
+        crc = updcrc16(0, buffer, len) ;
         crc = updcrc(0, crc) ; crc = updcrc(0, crc) ;
         trail[0] = crc / 256 ;
         trail[1] = crc % 256 ;
@@ -2459,15 +2461,36 @@ int Zmodem::YSendData(ZModem *info)
 {
     int i ;
 
-    /* are there characters still in the read buffer? */
+    m_dataPending = false ;
+
+    /* are there characters still in the read buffer?  If not, fill it
+     * from the read-ahead, going on from fileDataReady() when the I/O
+     * thread has not got that far yet */
 
     if (info->chrCount <= 0) {
         info->bufp = 0 ;
-        info->chrCount = fread(info->buffer, 1, info->packetsize, info->file);
-        info->fileEof = feof(info->file) ;
+        info->chrCount = 0 ;
+    }
+    while (info->bufp == 0 && info->chrCount < info->packetsize && !info->fileEof) {
+        const uchar *data ;
+        int avail = m_io->peek(&data) ;
+        if (avail < 0) {
+            m_dataPending = true ;
+            return 0 ;
+        }
+        if (avail == 0) {
+            info->fileEof = 1 ;
+            break ;
+        }
+        if (avail > info->packetsize - info->chrCount)
+            avail = info->packetsize - info->chrCount ;
+        memcpy(info->buffer + info->chrCount, data, avail) ;
+        m_io->consume(avail) ;
+        info->chrCount += avail ;
     }
 
     if (info->chrCount <= 0) {
+        m_io->stopRead() ;
         fclose(info->file) ;
         info->state = YTEOF ;
         return ZXmitStr(eotstr, 1, info) ;
@@ -2599,6 +2622,14 @@ int Zmodem::GotRinit(ZModem *info)
     else {
         info->Streaming = Segmented ;
     }
+
+    /* a receiver that streams without a buffer limit takes ZedZap's
+     * 8K subpackets, anybody else gets the classic 1K */
+    info->peerStreaming = info->Streaming ;
+    info->maxPacket = info->Streaming == Segmented ? 1024 : MaxPacket ;
+    if (info->packetsize > info->maxPacket)
+        info->packetsize = info->maxPacket ;
+    info->cleanCount = 0 ;
     // get filenames to transfer
     zmodemlog("GotRinit[%s]\n", sname(info)) ;
 
@@ -2650,13 +2681,39 @@ int Zmodem::SendZSInit(ZModem *info)
 
 int Zmodem::SendFileCrc(ZModem *info)
 {
-    ulong crc ;
+    /* the file is read on the I/O thread, the reply goes out from
+     * fileCrcReady() */
+    zmodemlog("SendFileCrc[%s]: %s\n", sname(info), info->filename) ;
+
+    m_io->startCrc(info->filename) ;
+    return 0 ;
+}
 
-    crc = FileCrc(info->filename) ;
+void Zmodem::fileDataReady()
+{
+    if (!m_dataPending)
+        return ;
+    switch (info.state) {
+    case Sending:
+        SendMoreFileData(&info) ;
+        break ;
+    case YTDataWait:
+    case YTData:
+        YSendData(&info) ;
+        break ;
+    default:
+        m_dataPending = false ;
+        break ;
+    }
+}
 
-    zmodemlog("SendFileCrc[%s]: %lx\n", sname(info), crc) ;
+void Zmodem::fileCrcReady(ulong crc)
+{
+    zmodemlog("fileCrcReady[%s]: %lx\n", sname(&info), crc) ;
 
-    return ZXmitHdrHex(ZCRC, ZEnc4(crc), info) ;
+    if (info.state != FileWait && info.state != CrcWait)
+        return ;
+    ZXmitHdrHex(ZCRC, ZEnc4(crc), &info) ;
 }
 
 int Zmodem::GotSendAck(ZModem *info)
@@ -2692,9 +2749,10 @@ int Zmodem::GotSendDoneAck(ZModem *info)
 
 int Zmodem::GotSendNak(ZModem *info)
 {
+    backoff(info) ;
     info->offset = info->zrposOffset ;
 
-    fseek(info->file, info->offset, 0) ;
+    m_io->startRead(info->file, info->offset) ;
 
     /* TODO: what if fseek fails?  Send EOF? */
 
@@ -2730,6 +2788,7 @@ int Zmodem::SkipFile(ZModem *info)
 {
     zmodemlog("SkipFile[%s]\n", sname(info)) ;
     ZStatus(FileEnd, 0, info->rfilename);
+    m_io->stopRead() ;
     fclose(info->file) ;
 
     // stupid SMTH doesnt send further command, kick
@@ -2738,9 +2797,23 @@ int Zmodem::SkipFile(ZModem *info)
     return GotRinit(info);
 }
 
+/* The receiver lost data.  Halve the subpacket size so less is resent
+ * next time, and have every subpacket acknowledged (ZCRCQ) until
+ * CleanPackets of them went through without complaint.
+ */
+void Zmodem::backoff(ZModem *info)
+{
+    info->cleanCount = 0 ;
+    if (info->packetsize / 2 >= MinPacket)
+        info->packetsize /= 2 ;
+    if (info->Streaming == Full || info->Streaming == StrWindow)
+        info->Streaming = SlidingWindow ;
+}
+
 int Zmodem::GotSendPos(ZModem *info)
 {
     ZStatus(DataErr, ++info->errCount, NULL) ;
+    backoff(info) ;
     info->waitflag = 1 ;  /* next pkt should wait, to resync */
     qDebug("GotSendPos, offset=%lx", info->offset);
     zmodemlog("GotSendPos[%s] %lx\n", sname(info), info->offset) ;
@@ -2779,7 +2852,7 @@ int Zmodem::startFileData(ZModem *info)
         info->lastOffset =
             info->zrposOffset = ZDec4(info->hdrData + 1) ;
 
-    fseek(info->file, info->offset, 0) ;
+    m_io->startRead(info->file, info->offset) ;
 
     /* TODO: what if fseek fails?  Send EOF? */
 
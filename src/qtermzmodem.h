@@ -22,6 +22,8 @@ class QTextCodec;
 
 namespace QTerm
 {
+class ZmodemIO;
+class Config;
 
 /* PARAMETERS
  *
@@ -47,6 +49,10 @@ namespace QTerm
 #define MaxNoise 64 /* max "noise" characters before transmission
 * pauses */
 #define MaxErrs  30 /* Max receive errors before cancel */
+#define MaxPacket 8192 /* largest data subpacket sent or accepted (ZedZap) */
+#define MinPacket 256 /* subpacket size is not halved below this */
+#define CleanPackets 16 /* error-free subpackets before the size grows
+* and streaming resumes */
 #define AlwaysSinit 1 /* always send ZSINIT header, even if not
 * needed, this makes protocol more robust */
 
@@ -169,6 +175,9 @@ typedef struct {
     ulong crc ;  /* crc of incoming header/data */
 //   enum enum_Streaming {Full, StrWindow, SlidingWindow, Segmented} Streaming ;
     enum_Streaming Streaming;
+    enum_Streaming peerStreaming; /* mode negotiated at ZRINIT */
+    int maxPacket ; /* largest subpacket the receiver takes */
+    int cleanCount ; /* subpackets sent since the last error */
 } ZModem ;
 
 
@@ -439,6 +448,7 @@ public:
 
     int FinishChar(char c, register ZModem *info) ;
     int DataChar(uchar c, register ZModem *info) ;
+    int DataBlock(uchar *str, int len, register ZModem *info) ;
     int HdrChar(uchar c, register ZModem *info) ;
     int IdleChar(uchar c, register ZModem *info) ;
 
@@ -480,12 +490,14 @@ public:
     int GotSendNak(ZModem *) ;
     int GotSendWaitAck(ZModem *) ;
     int SkipFile(ZModem *) ;
+    void backoff(ZModem *info) ;
     int GotSendPos(ZModem *) ;
 
 
 
 
     int requestFile(ZModem *info, ulong crc);
+    void closePartial(ZModem *info);
     void parseFileName(ZModem *info, char *fileinfo);
     int fileError(ZModem *info, int type, int data);
 
@@ -635,8 +647,18 @@ public slots:
     void zmodemCancel();
     int ZmodemTimeout() ;
     void setFileList(const QStringList & fileList);
+private slots:
+    void fileDataReady();
+    void fileCrcReady(ulong crc);
 private:
     QTextCodec * m_codec;
+    ZmodemIO * m_io;
+    /* a send stopped for data the I/O thread has not read yet */
+    bool m_dataPending;
+    /* files being received, kept until ZEOF so an interrupted
+     * download resumes where it stopped */
+    Config * m_journal;
+    QString m_journalKey;
 };
 
 } // namespace QTerm
@@ -11,12 +11,16 @@
 #include "qtermparam.h"
 #include "addrdialog.h"
 #include "qtermglobal.h"
+#include "qtermsiteindex.h"
 
 #include <QCloseEvent>
 #include <QComboBox>
 #include <QPixmap>
 #include <QMessageBox>
 #include <QUuid>
+#include <QCompleter>
+#include <QAbstractItemView>
+#include <QStandardItemModel>
 
 namespace QTerm
 {
@@ -39,6 +43,11 @@ quickDialog::quickDialog(QWidget* parent, Qt::WindowFlags fl)
 
     ui.connectPushButton->setDefault(true);
 
+    siteModel = new QStandardItemModel(this);
+    siteCompleter = new QCompleter(siteModel, this);
+    siteCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    siteCompleter->setWidget(ui.addrLineEdit);
+
     connectSlots();
 
     pConf = Global::instance()->fileCfg();
@@ -85,6 +94,36 @@ void quickDialog::connectSlots()
     connect(ui.advPushButton, SIGNAL(clicked()), this, SLOT(advOption()));
     connect(ui.connectPushButton, SIGNAL(clicked()), this, SLOT(connectIt()));
     connect(ui.closePushButton, SIGNAL(clicked()), this, SLOT(close()));
+    connect(ui.addrLineEdit, SIGNAL(textEdited(QString)), this, SLOT(findSites(QString)));
+    connect(siteCompleter, SIGNAL(activated(QModelIndex)), this, SLOT(siteChosen(QModelIndex)));
+}
+
+void quickDialog::findSites(const QString & text)
+{
+    siteModel->clear();
+    QDomDocument doc = Global::instance()->addrXml();
+    foreach (QString uuid, Global::instance()->siteIndex()->search(text, 10)) {
+        QDomElement site = Global::instance()->findSite(doc, uuid);
+        QStandardItem * item = new QStandardItem(QString("%1 (%2)")
+                .arg(site.attribute("name")).arg(site.attribute("addr")));
+        item->setData(uuid, Qt::UserRole);
+        siteModel->appendRow(item);
+    }
+    if (siteModel->rowCount() > 0)
+        siteCompleter->complete();
+    else
+        siteCompleter->popup()->hide();
+}
+
+// take over everything saved for the site, not only its address
+void quickDialog::siteChosen(const QModelIndex & index)
+{
+    QString uuid = index.data(Qt::UserRole).toString();
+    if (!Global::instance()->loadAddress(Global::instance()->addrXml(), uuid, param))
+        return;
+    ui.addrLineEdit->setText(param.m_mapParam["addr"].toString());
+    ui.portSpinBox->setValue(param.m_mapParam["port"].toInt());
+    ui.protocolComboBox->setCurrentIndex(param.m_mapParam["protocol"].toInt());
 }
 
 void quickDialog::listChanged(int index)
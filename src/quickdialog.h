@@ -15,6 +15,9 @@
 //#include <QCloseEvent>
 
 class QCloseEvent;
+class QCompleter;
+class QStandardItemModel;
+class QModelIndex;
 
 namespace QTerm
 {
@@ -37,6 +40,8 @@ protected slots:
     void advOption();
     void connectIt();
     void close();
+    void findSites(const QString & text);
+    void siteChosen(const QModelIndex & index);
 
 protected:
     void closeEvent(QCloseEvent *);
@@ -44,6 +49,9 @@ protected:
     void loadHistory();
 
     Config * pConf;
+    // saved sites matching what is typed as the address
+    QCompleter * siteCompleter;
+    QStandardItemModel * siteModel;
 
 private:
     Ui::quickDialog ui;
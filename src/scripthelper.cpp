@@ -5,26 +5,73 @@
 #include "qtermscreen.h"
 #include "qtermframe.h"
 #include "qtermbbs.h"
+#include "qtermsearch.h"
+#include "qtermhighlighter.h"
+#include "qtermarticle.h"
 #include "qtermtextline.h"
 #include "qtermzmodem.h"
 #include "qtermglobal.h"
+#include <QtCore/QDateTime>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QTime>
+#include <QtCore/QCoreApplication>
 #include <QAction>
 #include <QMenu>
 #include <QtScript>
 
 namespace QTerm
 {
-ScriptHelper::ScriptHelper(Window * parent, QScriptEngine * engine)
-    :QObject(parent),m_accepted(false),m_qtbindingsAvailable(true),m_scriptList(),m_popupActionList(),m_urlActionList()
+// scripts by file, read and checked once for every window; a program is
+// compiled by the engine evaluating it and again by the next one, so only
+// the windows of the shared engine also share the compiled code
+struct CachedProgram {
+    QDateTime modified;
+    qint64 size;
+    QScriptProgram program;
+};
+
+static QHash<QString, CachedProgram> & programCache()
 {
-    m_window = parent;
-    m_scriptEngine = engine;
-    m_scriptEngine->installTranslatorFunctions();
+    static QHash<QString, CachedProgram> cache;
+    return cache;
+}
+
+// read again once the file changes on disk
+static QScriptProgram cachedProgram(const QString & filename)
+{
+    QFileInfo info(filename);
+    QString path = info.absoluteFilePath();
+    QHash<QString, CachedProgram>::const_iterator it = programCache().constFind(path);
+    if (it != programCache().constEnd() && it.value().modified == info.lastModified()
+            && it.value().size == info.size())
+        return it.value().program;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QScriptProgram();
+    QString scripts = QString::fromUtf8(file.readAll());
+    file.close();
+    if (QScriptEngine::checkSyntax(scripts).state() != QScriptSyntaxCheckResult::Valid)
+        qDebug() << "Cannot evaluate this script";
+
+    CachedProgram entry;
+    entry.modified = info.lastModified();
+    entry.size = info.size();
+    entry.program = QScriptProgram(scripts, filename);
+    programCache().insert(path, entry);
+    return entry.program;
+}
+
+// translator functions and the Qt bindings, once per engine
+static bool setupEngine(QScriptEngine * engine)
+{
+    engine->installTranslatorFunctions();
 #if QT_VERSION >= 0x050000
-    m_qtbindingsAvailable = false;
+    return false;
 #else
+    bool available = true;
     QStringList allowedBindings;
     allowedBindings << "qt.core" << "qt.gui" << "qt.sql" << "qt.xml" << "qt.uitools" << "qt.network" << "qt.webkit";
     foreach( QString binding, allowedBindings )
@@ -38,15 +85,53 @@ ScriptHelper::ScriptHelper(Window * parent, QScriptEngine * engine)
         qDebug() << "Extension" << binding <<  "not found:" << error.toString();
         qDebug() << "Available extensions:" << engine->availableExtensions();
         qDebug() << "Some script functions will be disabled, considering install QtScriptBindings!";
-        m_qtbindingsAvailable = false;
+        available = false;
     }
-    if (m_qtbindingsAvailable)
+    if (available)
         qDebug() << "QtScriptBindings loaded, enjoy scripting!";
+    return available;
 #endif
 }
 
+// names of the hooks under QTerm, in the order of ScriptHelper::Hook
+static const char * const hookNames[ScriptHelper::HookCount] = {
+    "antiIdle", "autoReply", "onNewData", "onMouseEvent", "onWheelEvent",
+    "onKeyPressEvent", "onZmodemState", "onTelnetState", "onCopyArticle",
+    "setPageState", "setCursorType", "setSelectRect", "checkUrl", "checkIP"
+};
+
+ScriptHelper::ScriptHelper(Window * parent, QScriptEngine * engine, bool shared)
+    :QObject(parent),m_scope(),m_accepted(false),m_qtbindingsAvailable(true),m_scriptList(),m_popupActionList(),m_urlActionList(),
+     m_screen(),m_screenFirst(0),m_screenRows(),m_article(NULL),
+     m_hookMask(0),m_hookRunning(0),m_hooksResolved(false),m_hookState(NULL),m_hookAborted(false)
+{
+    m_window = parent;
+    m_scriptEngine = engine;
+    QVariant available = engine->property("qtbindingsAvailable");
+    if (!available.isValid()) {
+        available = setupEngine(engine);
+        engine->setProperty("qtbindingsAvailable", available);
+    }
+    m_qtbindingsAvailable = available.toBool();
+    m_hookState = static_cast<HookState *>(engine->property("hookState").value<void *>());
+    if (m_hookState == NULL) {
+        m_hookState = new HookState(engine);
+        engine->setProperty("hookState", QVariant::fromValue((void *) m_hookState));
+    }
+    m_scope = shared ? engine->newObject() : engine->globalObject();
+}
+
+QScriptEngine * ScriptHelper::sharedEngine()
+{
+    static QScriptEngine * engine = NULL;
+    if (engine == NULL)
+        engine = new QScriptEngine(qApp);
+    return engine;
+}
+
 ScriptHelper::~ScriptHelper()
 {
+    delete m_article;
 }
 
 bool ScriptHelper::accepted() const
@@ -172,6 +257,122 @@ QScriptValue ScriptHelper::getLine(int line)
     return m_scriptEngine->newQObject(obj);
 }
 
+// Scrolling moves lines between rows without changing them, so the rows
+// are told apart by the line each one shows as well as its revision
+QVector<ScriptHelper::Row> ScriptHelper::rows(int first, int count)
+{
+    QVector<Row> result;
+    result.reserve(count);
+    for (int i = first; i < first + count; i++) {
+        TextLine * line = m_window->m_pBuffer->screen(i);
+        result.append(Row(line, line != NULL ? line->revision() : 0));
+    }
+    return result;
+}
+
+// FNV-1a over the rows, cut to the 53 bits a double holds exactly
+quint64 ScriptHelper::revision(const QVector<Row> & rows)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    foreach (const Row & row, rows) {
+        hash = (hash ^ quint64(quintptr(row.first))) * Q_UINT64_C(1099511628211);
+        hash = (hash ^ row.second) * Q_UINT64_C(1099511628211);
+    }
+    return hash & ((Q_UINT64_C(1) << 53) - 1);
+}
+
+double ScriptHelper::screenRevision(int first, int count)
+{
+    if (count < 0)
+        count = m_window->m_pBuffer->line() - first;
+    return revision(rows(first, count));
+}
+
+// text, color and attr of the rows in one value, color and attr are
+// strings with one character per column
+QScriptValue ScriptHelper::getScreen(int first, int count)
+{
+    Buffer * buffer = m_window->m_pBuffer;
+    first = qBound(0, first, buffer->line());
+    if (count < 0 || first + count > buffer->line())
+        count = buffer->line() - first;
+    QVector<Row> current = rows(first, count);
+    if (m_screen.isValid() && first == m_screenFirst && current == m_screenRows)
+        return m_screen;
+
+    QScriptValue text = m_scriptEngine->newArray(count);
+    QScriptValue color = m_scriptEngine->newArray(count);
+    QScriptValue attr = m_scriptEngine->newArray(count);
+    for (int i = 0; i < count; i++) {
+        TextLine * line = buffer->screen(first + i);
+        QByteArray bytes = line->getColor();
+        text.setProperty(i, line->getText());
+        color.setProperty(i, QString::fromLatin1(bytes.constData(), bytes.size()));
+        bytes = line->getAttr();
+        attr.setProperty(i, QString::fromLatin1(bytes.constData(), bytes.size()));
+    }
+    QScriptValue screen = m_scriptEngine->newObject();
+    screen.setProperty("revision", double(revision(current)));
+    screen.setProperty("first", first);
+    screen.setProperty("text", text);
+    screen.setProperty("color", color);
+    screen.setProperty("attr", attr);
+
+    m_screen = screen;
+    m_screenFirst = first;
+    m_screenRows = current;
+    return screen;
+}
+
+void ScriptHelper::startArticle()
+{
+    delete m_article;
+    m_article = new ArticleCapture;
+}
+
+// add the screen without the status line to the article
+void ScriptHelper::addArticlePage()
+{
+    if (m_article == NULL)
+        return;
+    QStringList page;
+    for (int i = 0; i < m_window->m_pBuffer->line() - 1; i++)
+        page << ArticleCapture::stripRight(m_window->m_pBuffer->screen(i)->getText());
+    m_article->addPage(page);
+}
+
+QString ScriptHelper::finishArticle()
+{
+    if (m_article == NULL)
+        return QString();
+    QString text = m_article->finish();
+    delete m_article;
+    m_article = NULL;
+    return text;
+}
+
+// highlight pattern in the whole buffer, returns the number of lines
+int ScriptHelper::find(const QString & pattern, bool regex)
+{
+    int count = m_window->m_pSearch->find(pattern, regex);
+    m_window->on_actionRefresh_triggered();
+    return count;
+}
+
+bool ScriptHelper::addHighlightRule(const QString & pattern, int attr, bool regex)
+{
+    if (!m_window->m_pHighlighter->addRule(pattern, attr, regex))
+        return false;
+    m_window->on_actionRefresh_triggered();
+    return true;
+}
+
+void ScriptHelper::clearHighlightRules()
+{
+    m_window->m_pHighlighter->clear();
+    m_window->on_actionRefresh_triggered();
+}
+
 QScriptValue ScriptHelper::window()
 {
     return m_scriptEngine->newQObject(m_window);
@@ -188,7 +389,7 @@ bool ScriptHelper::addPopupMenu(QString id, QString menuTitle, QString icon)
     QMenu * popupMenu = m_window->popupMenu();
     popupMenu->addAction(action);
     QScriptValue newItem = m_scriptEngine->newQObject( action );
-    m_scriptEngine->globalObject().property( "QTerm" ).setProperty( id, newItem );
+    m_scope.property( "QTerm" ).setProperty( id, newItem );
     m_popupActionList << id;
     return true;
 }
@@ -204,7 +405,7 @@ bool ScriptHelper::addUrlMenu(QString id, QString menuTitle, QString icon)
     QMenu * urlMenu = m_window->urlMenu();
     urlMenu->addAction(action);
     QScriptValue newItem = m_scriptEngine->newQObject( action );
-    m_scriptEngine->globalObject().property( "QTerm" ).setProperty( id, newItem );
+    m_scope.property( "QTerm" ).setProperty( id, newItem );
     m_urlActionList << id;
     return true;
 }
@@ -296,15 +497,152 @@ QString ScriptHelper::version()
     return QTERM_VERSION;
 }
 
+void ScriptHelper::resolveHooks()
+{
+    QScriptValue qterm = m_scope.property("QTerm");
+    m_hookMask = 0;
+    for (int i = 0; i < HookCount; i++) {
+        QScriptValue func = qterm.property(hookNames[i]);
+        if (func.isFunction()) {
+            m_hooks[i] = func;
+            m_hookMask |= 1u << i;
+        } else {
+            m_hooks[i] = QScriptValue();
+        }
+    }
+    m_hooksResolved = true;
+}
+
+void HookState::enter(int budget)
+{
+    Call call;
+    call.started.start();
+    call.budget = budget;
+    call.aborted = false;
+    m_calls.append(call);
+    // a debugger attached to the engine takes the place of the watchdog
+    if (budget > 0 && engine()->agent() == NULL)
+        engine()->setAgent(this);
+}
+
+bool HookState::leave()
+{
+    bool aborted = m_calls.last().aborted;
+    m_calls.removeLast();
+    return aborted;
+}
+
+void HookState::positionChange(qint64 scriptId, int lineNumber, int columnNumber)
+{
+    Q_UNUSED(scriptId);
+    Q_UNUSED(lineNumber);
+    Q_UNUSED(columnNumber);
+    // the clock is read every 1024 statements
+    if ((++m_steps & 0x3ff) != 0 || m_calls.isEmpty())
+        return;
+    Call & call = m_calls.last();
+    if (call.budget > 0 && !call.aborted && call.started.elapsed() > call.budget) {
+        call.aborted = true;
+        engine()->abortEvaluation();
+    }
+}
+
+QScriptValue ScriptHelper::timedCall(const QScriptValue & func, const QScriptValueList & args,
+                                     const QString & name, int budget, int & elapsed)
+{
+    QTime time;
+    time.start();
+    m_hookState->enter(budget);
+    QScriptValue result = func.call(QScriptValue(), args);
+    m_hookAborted = m_hookState->leave();
+    elapsed = time.elapsed();
+    if (m_hookAborted) {
+        m_accepted = false;
+        qDebug() << name << "ran over" << budget << "ms and was aborted";
+    }
+    return result;
+}
+
+QScriptValue ScriptHelper::callHook(Hook h, const QScriptValueList & args)
+{
+    int budget = h == OnCopyArticle ? 0 : Global::instance()->m_pref.nScriptBudget;
+    int elapsed;
+    m_hookRunning |= 1u << h;
+    QScriptValue result = timedCall(m_hooks[h], args, hookNames[h], budget, elapsed);
+    m_hookRunning &= ~(1u << h);
+    HookStats & stats = m_hookStats[h];
+    stats.calls++;
+    stats.total += elapsed;
+    stats.worst = qMax(stats.worst, elapsed);
+    if (m_hookAborted)
+        stats.aborted++;
+    return result;
+}
+
+QScriptValue ScriptHelper::callFunction(const QString & name, const QScriptValueList & args)
+{
+    QScriptValue func = m_scope.property("QTerm").property(name);
+    if (!func.isFunction()) {
+        qDebug() << name << "is not a function";
+        return QScriptValue();
+    }
+    int elapsed;
+    return timedCall(func, args, name, Global::instance()->m_pref.nScriptBudget, elapsed);
+}
+
+// calls, aborted calls, total and worst ms by hook name
+QScriptValue ScriptHelper::hookStats()
+{
+    QScriptValue result = m_scriptEngine->newObject();
+    for (int i = 0; i < HookCount; i++) {
+        const HookStats & stats = m_hookStats[i];
+        if (stats.calls == 0)
+            continue;
+        QScriptValue item = m_scriptEngine->newObject();
+        item.setProperty("calls", stats.calls);
+        item.setProperty("aborted", stats.aborted);
+        item.setProperty("total", (double) stats.total);
+        item.setProperty("worst", stats.worst);
+        result.setProperty(hookNames[i], item);
+    }
+    return result;
+}
+
+bool ScriptHelper::setHook(const QString & name, const QScriptValue & func)
+{
+    QScriptValue qterm = m_scope.property("QTerm");
+    if (!qterm.isObject())
+        return false;
+    qterm.setProperty(name, func);
+    m_hooksResolved = false;
+    return true;
+}
+
+// for scripts assigning QTerm.* directly after they were loaded
+void ScriptHelper::updateHooks()
+{
+    m_hooksResolved = false;
+}
+
 void ScriptHelper::loadScriptFile(const QString & filename)
 {
-    QFile file(filename);
-    file.open(QIODevice::ReadOnly);
-    QString scripts = QString::fromUtf8(file.readAll());
-    file.close();
-    if (!m_scriptEngine->canEvaluate(scripts))
-        qDebug() << "Cannot evaluate this script";
-    m_scriptEngine->evaluate(scripts, filename);
+    m_hooksResolved = false;
+    QScriptProgram program = cachedProgram(filename);
+    if (program.isNull()) {
+        qDebug() << "Cannot read script file: " << filename;
+        return;
+    }
+    if (m_scope.strictlyEquals(m_scriptEngine->globalObject())) {
+        m_scriptEngine->evaluate(program);
+    } else {
+        // declarations land in the scope, functions keep it as they are
+        // called later from anywhere
+        QScriptContext * context = m_scriptEngine->pushContext();
+        context->setActivationObject(m_scope);
+        context->setThisObject(m_scope);
+        m_scriptEngine->evaluate(program);
+        m_scriptEngine->popContext();
+    }
     if (m_scriptEngine->hasUncaughtException()) {
         qDebug() << "Exception: " << m_scriptEngine->uncaughtExceptionBacktrace();
     }
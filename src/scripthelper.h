@@ -1,22 +1,78 @@
 #ifndef SCRIPT_H
 #define SCRIPT_H
 #include <QtCore/QObject>
+#include <QtCore/QPair>
 #include <QtCore/QStringList>
+#include <QtCore/QTime>
+#include <QtCore/QVector>
 #include <QtScript>
 
 namespace QTerm
 {
 class Window;
 class TextLine;
+class ArticleCapture;
+class ScriptHelper;
+
+// the timed calls running on a script engine, innermost last, shared by the
+// windows using it; as the agent of the engine it aborts the innermost call
+// once that runs over its budget, without handing over to the event loop
+class HookState : public QScriptEngineAgent
+{
+public:
+    HookState(QScriptEngine * engine)
+        : QScriptEngineAgent(engine), m_steps(0) {}
+    // budget in ms, 0 for none
+    void enter(int budget);
+    // whether the call was aborted
+    bool leave();
+    void positionChange(qint64 scriptId, int lineNumber, int columnNumber);
+private:
+    struct Call {
+        QTime started;
+        int budget;
+        bool aborted;
+    };
+    QVector<Call> m_calls;
+    uint m_steps;
+};
+
 class ScriptHelper : public QObject
 {
     Q_OBJECT
 public:
-    ScriptHelper(Window *parent, QScriptEngine *engine);
+    // the QTerm.* functions called on terminal events
+    enum Hook {
+        AntiIdle, AutoReply, OnNewData, OnMouseEvent, OnWheelEvent,
+        OnKeyPressEvent, OnZmodemState, OnTelnetState, OnCopyArticle,
+        SetPageState, SetCursorType, SetSelectRect, CheckUrl, CheckIP,
+        HookCount
+    };
+    // with shared set the engine is used by other windows too and the
+    // scripts of this one run in a scope of their own
+    ScriptHelper(Window *parent, QScriptEngine *engine, bool shared = false);
     ~ScriptHelper();
+    static QScriptEngine * sharedEngine();
+    // what the scripts of this window see as the global object
+    QScriptValue scope() const {
+        return m_scope;
+    }
     Q_PROPERTY(bool accepted READ accepted WRITE setAccepted)
     Q_PROPERTY(bool qtbindingsAvailable READ qtbindingsAvailable)
     void loadScriptFile(const QString&);
+    // looked up once, so events without a handler cost a bit test; a
+    // handler is not entered again while it is running for this window
+    bool hasHook(Hook h) {
+        if (!m_hooksResolved)
+            resolveHooks();
+        return m_hookMask & ~m_hookRunning & (1u << h);
+    }
+    // timed, and aborted once it runs over the budget of the preferences;
+    // onCopyArticle() waits for the article to come in and has no budget
+    QScriptValue callHook(Hook h, const QScriptValueList & args = QScriptValueList());
+    // any function under QTerm, within the same budget
+    QScriptValue callFunction(const QString & name, const QScriptValueList & args = QScriptValueList());
+    void resolveHooks();
 public slots:
     bool accepted() const;
     bool qtbindingsAvailable() const;
@@ -42,6 +98,14 @@ public slots:
     void cancelZmodem();
     void setZmodemFileList(const QStringList & fileList);
     QScriptValue getLine(int line);
+    double screenRevision(int first = 0, int count = -1);
+    QScriptValue getScreen(int first = 0, int count = -1);
+    void startArticle();
+    void addArticlePage();
+    QString finishArticle();
+    int find(const QString & pattern, bool regex = false);
+    bool addHighlightRule(const QString & pattern, int attr, bool regex = false);
+    void clearHighlightRules();
     QScriptValue window();
     bool addPopupMenu(QString id, QString menuTitle, QString icon = "QTerm");
     bool addUrlMenu(QString id, QString menuTitle, QString icon = "QTerm");
@@ -55,19 +119,48 @@ public slots:
     bool loadExtension(const QString & extension);
     QString version();
     QString findFile(const QString & filename);
+    bool setHook(const QString & name, const QScriptValue & func);
+    void updateHooks();
+    QScriptValue hookStats();
 signals:
     void scriptEvent(const QString & type);
     void eventFinished();
 private:
+    struct HookStats {
+        HookStats() : calls(0), aborted(0), total(0), worst(0) {}
+        int calls;
+        int aborted;
+        qint64 total;   // ms
+        int worst;
+    };
     bool isScriptLoaded(const QString & filename);
     void addImportedScript(const QString & filename);
+    // a line on the screen and its revision
+    typedef QPair<TextLine *, quint64> Row;
+    QVector<Row> rows(int first, int count);
+    quint64 revision(const QVector<Row> & rows);
+    QScriptValue timedCall(const QScriptValue & func, const QScriptValueList & args,
+                           const QString & name, int budget, int & elapsed);
     Window * m_window;
     QScriptEngine * m_scriptEngine;
+    QScriptValue m_scope;
     bool m_accepted;
     bool m_qtbindingsAvailable;
     QStringList m_scriptList;
     QStringList m_popupActionList;
     QStringList m_urlActionList;
+    // the last getScreen() result, handed out again while unchanged
+    QScriptValue m_screen;
+    int m_screenFirst;
+    QVector<Row> m_screenRows;
+    ArticleCapture * m_article;
+    QScriptValue m_hooks[HookCount];
+    quint32 m_hookMask;
+    quint32 m_hookRunning;
+    bool m_hooksResolved;
+    HookStats m_hookStats[HookCount];
+    HookState * m_hookState;
+    bool m_hookAborted;
 };
 } // namespace QTerm
 
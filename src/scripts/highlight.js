@@ -1,16 +1,15 @@
 QTerm.loadScript("utils.js");
-QTerm.highlightKeywords = function(pattern)
+// Register keywords to highlight, pattern is a RegExp or an array of plain
+// keywords, case is ignored. QTerm matches the lines that changed and draws
+// the color over the text, so call this once instead of in onNewData.
+QTerm.highlightKeywords = function(pattern, color)
 {
-    for (var i = 0; i < QTerm.rows(); i++) {
-        var line = QTerm.getLine(i);
-        var text = line.getText();
-        pattern.lastIndex = 0;
-        while ((result = pattern.exec(text)) != null) {
-            var index = line.beginIndex(result.index);
-            // Definition of color and attr can be found in qterm.h, The actuall color might change once we have schema support back
-            var color = QTerm.setAttr(QTerm.Attr.Default|QTerm.Attr.Bold)|QTerm.setColor(QTerm.setFG(QTerm.Color.Red)|QTerm.setBG(QTerm.Color.Black));
-            line.replaceText(result[0],color,index, -1);
-        }
-    }
+    // Definition of color and attr can be found in qterm.h, The actuall color might change once we have schema support back
+    if (color == undefined)
+        color = QTerm.setAttr(QTerm.Attr.Default|QTerm.Attr.Bold)|QTerm.setColor(QTerm.setFG(QTerm.Color.Red)|QTerm.setBG(QTerm.Color.Black));
+    if (pattern instanceof RegExp)
+        return QTerm.addHighlightRule(pattern.source, color, true);
+    for (var i = 0; i < pattern.length; i++)
+        QTerm.addHighlightRule(pattern[i], color, false);
+    return true;
 }
-
@@ -17,6 +17,7 @@ QTerm.pageState = QTerm.PTT.Unknown;
 QTerm.init = function()
 {
     QTerm.osdMessage("system script loaded", QTerm.OSDType.Info, 10000);
+    QTerm.highlightKeywords(["qterm", "kde"]);
 }
 
 QTerm.setCursorType = function(x,y)
@@ -33,9 +34,13 @@ QTerm.setCursorType = function(x,y)
 QTerm.setPageState = function()
 {
     QTerm.accepted = true;
-    var title = QTerm.getText(0);
-    var bottom = QTerm.getText(QTerm.rows()-1);
-    var third = QTerm.getText(2);
+    var screen = QTerm.getScreen();
+    if (screen.revision == QTerm.pageRevision)
+        return QTerm.pageState;
+    QTerm.pageRevision = screen.revision;
+    var title = screen.text[0];
+    var bottom = screen.text[QTerm.rows()-1];
+    var third = screen.text[2];
     QTerm.pageState = QTerm.PTT.Unknown;
     var menuList = ["【主功能表】","【電子郵件】","【聊天說話】","【個人設定】","【工具程式】"];
     var listList = ["【看板列表】","【精華文章】","【分類看板】","【休閒聊天】"];
@@ -161,7 +166,6 @@ QTerm.onNewData = function()
 {
     QTerm.accepted = false;
     QTerm.scriptEvent("QTerm: new data");
-    QTerm.highlightKeywords(/qterm|kde/ig);
     return false;
 }
 
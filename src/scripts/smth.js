@@ -19,7 +19,8 @@ QTerm.init = function()
     if (QTerm.addPopupMenu( "aboutScript", qsTr("About This Script") ) ) {
         QTerm.aboutScript.triggered.connect(QTerm.onAbout);
     }
-
+    // This will highlight qterm and kde, function defined in highlight.js
+    QTerm.highlightKeywords(["qterm", "kde"]);
 }
 
 QTerm.setCursorType = function(x,y)
@@ -42,9 +43,13 @@ QTerm.setCursorType = function(x,y)
 QTerm.setPageState = function()
 {
     QTerm.accepted = true;
-    var title = QTerm.getText(0);
-    var bottom = QTerm.getText(QTerm.rows()-1);
-    var third = QTerm.getText(2);
+    var screen = QTerm.getScreen();
+    if (screen.revision == QTerm.pageRevision)
+        return QTerm.pageState;
+    QTerm.pageRevision = screen.revision;
+    var title = screen.text[0];
+    var bottom = screen.text[QTerm.rows()-1];
+    var third = screen.text[2];
     QTerm.pageState = QTerm.SMTH.Unknown;
     var menuList = ["主选单","聊天选单","[处理信笺选单]","工具箱选单","分类讨论区选单","系统资讯选单"];
     var listList = ["[好朋友列表]","[讨论区列表]","邮件选单","[个人定制区]"];
@@ -201,9 +206,7 @@ QTerm.onWheelEvent = function(delta, buttons, modifiers, orientation, pt_x, pt_y
 QTerm.onNewData = function()
 {
     QTerm.accepted = false;
-    // This will highlight qterm and kde, function defined in highlight.js
     QTerm.scriptEvent("QTerm: new data");
-    QTerm.highlightKeywords(/qterm|kde/ig);
     return false;
 }
 
@@ -99,5 +99,5 @@ QTerm.OSDType = {
 }
 
 QTerm.getText = function(line) {
-    return QTerm.getLine(line).getText();
+    return QTerm.getScreen().text[line];
 }
@@ -74,6 +74,12 @@ void SSH2Channel::channelPacketReceived(int flag)
         qDebug() << "want reply " << m_in->getUInt8();
 #endif
         break;
+    case SSH2_MSG_KEXINIT:
+    case SSH2_MSG_NEWKEYS:
+    case SSH2_MSG_KEXDH_INIT:
+    case SSH2_MSG_KEXDH_REPLY:
+        // handled by SSH2Kex during a rekey
+        break;
     default:
         qDebug("unknown packet: %d", flag);
         break;
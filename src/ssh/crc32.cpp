@@ -93,13 +93,37 @@ static const uint32_t crc32tab[] =
         0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL, 0x2d02ef8dL
     };
 
+/* Slicing-by-8 tables derived from crc32tab, slice 0 is crc32tab itself */
+static uint32_t crc32slice[8][256];
+
+static struct crc32_slice_init {
+    crc32_slice_init()
+    {
+        int k, n;
+        for (n = 0; n < 256; n++)
+            crc32slice[0][n] = crc32tab[n];
+        for (k = 1; k < 8; k++)
+            for (n = 0; n < 256; n++)
+                crc32slice[k][n] = (crc32slice[k-1][n] >> 8) ^
+                    crc32tab[crc32slice[k-1][n] & 0xff];
+    }
+} crc32_slice_init_instance;
+
 uint32_t
 ssh_crc32(const uint8_t *buf, uint32_t size)
 {
-    uint32_t i, crc;
+    uint32_t one, crc;
 
     crc = 0;
-    for (i = 0;  i < size;  i++)
-        crc = crc32tab[(crc ^ buf[i]) & 0xff] ^(crc >> 8);
+    for (; size >= 8; size -= 8, buf += 8) {
+        one = crc ^ (buf[0] | (buf[1] << 8) | (buf[2] << 16) |
+            ((uint32_t)buf[3] << 24));
+        crc = crc32slice[7][one & 0xff] ^ crc32slice[6][(one >> 8) & 0xff] ^
+            crc32slice[5][(one >> 16) & 0xff] ^ crc32slice[4][one >> 24] ^
+            crc32slice[3][buf[4]] ^ crc32slice[2][buf[5]] ^
+            crc32slice[1][buf[6]] ^ crc32slice[0][buf[7]];
+    }
+    while (size-- > 0)
+        crc = crc32tab[(crc ^ *buf++) & 0xff] ^(crc >> 8);
     return crc;
 }
@@ -100,6 +100,7 @@ void SSH2Kex::sendKex()
 //  m_compCS = m_compSC = "none";
     QByteArray cookie;
 
+    m_out->beginKex();
     m_out->startPacket(SSH2_MSG_KEXINIT);
     cookie.resize(16);
 
@@ -259,12 +260,14 @@ void SSH2Kex::kexPacketReceived(int flag)
         readKexReply();
         break;
     case SSH2_MSG_NEWKEYS:
-        if (m_status == NewKeysSent) {
-            m_in->setTransport(m_inTrans);
-            m_out->setTransport(m_outTrans);
-            emit kexFinished(m_sessionID);
-        } else
-            m_status = NewKeysReceived;
+        // The server sends NEWKEYS after its KEXDH_REPLY, which is where
+        // the new transports are set up.
+        if (m_status != NewKeysSent) {
+            qDebug("unexpected NEWKEYS");
+            break;
+        }
+        m_in->setTransport(m_inTrans);
+        finishKex();
         break;
     default:
         break;
@@ -312,12 +315,20 @@ void SSH2Kex::readKexReply()
         m_sessionID = key;
     initTransport(key);
 
-    if (m_status == NewKeysReceived) {
-        m_in->setTransport(m_inTrans);
-        m_out->setTransport(m_outTrans);
-        emit kexFinished(m_sessionID);
-    } else
-        m_status = NewKeysSent;
+    // Everything after our NEWKEYS goes out with the new keys, including
+    // the channel data held back during the exchange.
+    m_out->setTransport(m_outTrans);
+    m_out->endKex();
+    m_status = NewKeysSent;
+}
+
+void SSH2Kex::finishKex()
+{
+    // Ready for the next key exchange, from either side
+    m_status = Init;
+    m_inTrans = NULL;
+    m_outTrans = NULL;
+    emit kexFinished(m_sessionID);
 }
 
 void SSH2Kex::initTransport(const QByteArray & hash)
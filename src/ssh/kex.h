@@ -38,6 +38,10 @@ public:
     void sendKex();
     void startBinary();
     void setHostInfo(HostInfo * hostInfo);
+    bool isRunning() const
+    {
+        return m_status != Init;
+    }
 
 signals:
     void kexFinished(const QByteArray & sessionID);
@@ -55,6 +59,7 @@ private:
     void DHGroup14();
     QString chooseAlgorithm(const QStringList & target, const QStringList & available);
     void initTransport(const QByteArray & hash);
+    void finishKex();
     enum Status
     {
         Init, KexSent, NewKeysReceived, NewKeysSent
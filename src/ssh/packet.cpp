@@ -12,6 +12,7 @@
 
 #include "packet.h"
 #include "crc32.h"
+#include "ssh2.h"
 #include <openssl/rand.h>
 
 #ifdef SSH_DEBUG
@@ -75,7 +76,7 @@ namespace QTerm
 {
 SSH2InBuffer::SSH2InBuffer(SocketPrivate * plainSocket, QObject * parent)
         : QObject(parent), m_in(), m_out(), m_buf(this),
-        m_sequenceNumber(0),m_incompletePacket()
+        m_sequenceNumber(0),m_incompletePacket(), m_byteCount(0)
 {
     m_buf.setBuffer(&m_out);
     m_buf.open(QBuffer::ReadWrite);
@@ -92,8 +93,6 @@ void SSH2InBuffer::parseData()
 {
     if (m_socket == NULL)
         return;
-    int blockSize = m_transport == NULL ? 8 : m_transport->blockSize();
-    int macLen = m_transport == NULL ? 0 : m_transport->macLen();
     qint64 nbyte = m_socket->bytesAvailable();
     QByteArray from_socket = m_socket->readBlock(nbyte);
 
@@ -102,6 +101,10 @@ void SSH2InBuffer::parseData()
 
     // Parse packet
     while (m_in.size() > 8) {
+        // The transport may change in the middle of a read when NEWKEYS
+        // arrives, so the sizes are taken per packet.
+        int blockSize = m_transport == NULL ? 8 : m_transport->blockSize();
+        int macLen = m_transport == NULL ? 0 : m_transport->macLen();
 
 //   qDebug() << n << "bytes available";
 
@@ -170,6 +173,7 @@ void SSH2InBuffer::parseData()
             m_in.remove(0, length + 4 + macLen);
         else
             m_in.remove(0, length + 4);
+        m_byteCount += length + 4 + macLen;
 
 //   qDebug() << "Read " << nread << "bytes data";
 //   dumpData ( m_out );
@@ -391,7 +395,7 @@ void SSH1InBuffer::parseData()
 
 SSH2OutBuffer::SSH2OutBuffer(SocketPrivate * plainSocket, QObject * parent)
         : QObject(parent), m_in(), m_buf(this),
-        m_sequenceNumber(0)
+        m_sequenceNumber(0), m_byteCount(0), m_kexInProgress(false), m_pending()
 {
     m_buf.setBuffer(&m_in);
     m_buf.open(QBuffer::ReadWrite);
@@ -474,7 +478,38 @@ void SSH2OutBuffer::putBN(const BIGNUM * value)
     return;
 }
 
+void SSH2OutBuffer::beginKex()
+{
+    m_kexInProgress = true;
+}
+
+void SSH2OutBuffer::endKex()
+{
+    m_kexInProgress = false;
+    QList<QByteArray> pending = m_pending;
+    m_pending.clear();
+    foreach(const QByteArray & payload, pending) {
+        m_in = payload;
+        writePacket();
+    }
+    startPacket();
+}
+
 void SSH2OutBuffer::sendPacket()
+{
+    // RFC 4253 7.1: between KEXINIT and NEWKEYS only transport and kex
+    // messages may be sent, everything else waits for the new keys.
+    if (m_kexInProgress && !m_in.isEmpty()) {
+        uint8_t flag = m_in[0];
+        if (flag > SSH2_MSG_DEBUG && (flag < SSH2_MSG_KEXINIT || flag > 49)) {
+            m_pending << m_in;
+            return;
+        }
+    }
+    writePacket();
+}
+
+void SSH2OutBuffer::writePacket()
 {
     int blockSize;
     if (m_transport != NULL)
@@ -513,6 +548,7 @@ void SSH2OutBuffer::sendPacket()
         packet = plain;
     qint64 nwrite = m_socket->writeBlock(packet);
     m_sequenceNumber++;
+    m_byteCount += packet.size();
     if (nwrite < packet.size())
         qDebug("packet write too small");
 }
@@ -19,6 +19,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QByteArray>
 #include <QtCore/QBuffer>
+#include <QtCore/QList>
 
 namespace QTerm
 {
@@ -44,6 +45,13 @@ public:
     {
         delete m_transport;
         m_transport = theValue;
+        m_byteCount = 0;
+    }
+
+    // Bytes received with the current keys
+    quint64 byteCount() const
+    {
+        return m_byteCount;
     }
 
 signals:
@@ -61,6 +69,7 @@ private:
     SSH2Transport * m_transport;
     uint32_t m_sequenceNumber;
     QByteArray m_incompletePacket;
+    quint64 m_byteCount;
 };
 
 class SSH1InBuffer : public QObject
@@ -112,19 +121,33 @@ public:
     void putBN(const BIGNUM * bn);
     void sendPacket();
     QByteArray & buffer();   // TODO: ugly
+    void beginKex();
+    void endKex();
 
     void setTransport(SSH2Transport* theValue)
     {
         delete m_transport;
         m_transport = theValue;
+        m_byteCount = 0;
+    }
+
+    // Bytes sent with the current keys
+    quint64 byteCount() const
+    {
+        return m_byteCount;
     }
 
 private:
+    void writePacket();
     QByteArray m_in;
     QBuffer m_buf;
     SocketPrivate * m_socket;
     SSH2Transport * m_transport;
     uint32_t m_sequenceNumber;
+    quint64 m_byteCount;
+    // Non-kex payloads held back between KEXINIT and NEWKEYS
+    bool m_kexInProgress;
+    QList<QByteArray> m_pending;
 };
 
 
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <openssl/evp.h>
 #include <QtCore/QStringList>
+#include <QtCore/QTimer>
 
 #ifdef SSH_DEBUG
 #include <QtDebug>
@@ -31,6 +32,10 @@
 #define QTERM_SSHV1_BANNER "SSH-1.5-QTermSSH\n"
 #define QTERM_SSHV2_BANNER "SSH-2.0-QTermSSH\r\n"
 
+// Rekey limits recommended by RFC 4253 section 9
+#define QTERM_SSH_REKEY_BYTES (Q_UINT64_C(1) << 30)
+#define QTERM_SSH_REKEY_INTERVAL (60 * 60 * 1000)
+
 namespace QTerm
 {
 SSH2SocketPriv::SSH2SocketPriv(SocketPrivate * plainSocket, QByteArray & banner, QObject * parent)
@@ -41,7 +46,11 @@ SSH2SocketPriv::SSH2SocketPriv(SocketPrivate * plainSocket, QByteArray & banner,
 #endif
     m_sessionID = NULL;
     m_auth = NULL;
+    m_channel = NULL;
     m_hostInfo = plainSocket->hostInfo();
+    m_rekeyTimer = new QTimer(this);
+    m_rekeyTimer->setSingleShot(true);
+    connect(m_rekeyTimer, SIGNAL(timeout()), this, SLOT(slotRekeyTimeout()));
     m_inPacket = new SSH2InBuffer(plainSocket, this);
     m_outPacket = new SSH2OutBuffer(plainSocket, this);
     m_kex = new SSH2Kex(m_inPacket, m_outPacket, m_banner, QTERM_SSHV2_BANNER, this);
@@ -63,8 +72,16 @@ SSH2SocketPriv::~SSH2SocketPriv()
 
 void SSH2SocketPriv::slotKexFinished(const QByteArray & sessionID)
 {
+    // The kex object stays around for the lifetime of the connection, it
+    // handles rekeying started by either side.
+    m_rekeyTimer->start(QTERM_SSH_REKEY_INTERVAL);
+    if (!m_sessionID.isEmpty()) {
+#ifdef SSH_DEBUG
+        qDebug() << "rekey finished";
+#endif
+        return;
+    }
     m_sessionID = sessionID;
-    m_kex->deleteLater();
 #ifdef SSH_DEBUG
     qDebug() << "kex finished";
 #endif
@@ -104,10 +121,34 @@ void SSH2SocketPriv::slotChannelClosed(int id)
 
 void SSH2SocketPriv::slotChannelData(int id)
 {
+    checkRekey();
     if (id == 0)
         emit readyRead();
 }
 
+void SSH2SocketPriv::checkRekey()
+{
+    if (m_channel == NULL || m_kex->isRunning())
+        return;
+    if (m_inPacket->byteCount() >= QTERM_SSH_REKEY_BYTES
+            || m_outPacket->byteCount() >= QTERM_SSH_REKEY_BYTES) {
+#ifdef SSH_DEBUG
+        qDebug() << "rekey after" << m_inPacket->byteCount() << m_outPacket->byteCount() << "bytes";
+#endif
+        m_kex->sendKex();
+    }
+}
+
+void SSH2SocketPriv::slotRekeyTimeout()
+{
+    if (m_channel == NULL || m_kex->isRunning())
+        return;
+#ifdef SSH_DEBUG
+    qDebug() << "rekey after timeout";
+#endif
+    m_kex->sendKex();
+}
+
 QByteArray SSH2SocketPriv::readData(unsigned long size)
 {
     return m_channel->readData(0, size);
@@ -115,7 +156,9 @@ QByteArray SSH2SocketPriv::readData(unsigned long size)
 
 void SSH2SocketPriv::writeData(const QByteArray & data)
 {
+    // Data written during a key exchange is queued by m_outPacket
     m_channel->writeData(0, data);
+    checkRekey();
 }
 
 unsigned long SSH2SocketPriv::bytesAvailable()
@@ -15,6 +15,8 @@
 #include "qtermsocket.h"
 #include <QtCore/QObject>
 
+class QTimer;
+
 namespace QTerm
 {
 class HostInfo;
@@ -71,7 +73,9 @@ private slots:
     void slotNewChannel(int id);
     void slotChannelData(int id);
     void slotChannelClosed(int id);
+    void slotRekeyTimeout();
 private:
+    void checkRekey();
     enum SSHStatus
     {
         Init, Kex, Unknown
@@ -86,6 +90,7 @@ private:
     QByteArray m_sessionID;
     QList<uint> m_channelList;
     HostInfo * m_hostInfo;
+    QTimer * m_rekeyTimer;
 };
 
 class SSH1SocketPriv : public SSHSocketPriv
@@ -127,6 +127,13 @@ QString TermString::string()
 }
 
 QString TermString::mid(int index, int len)
+{
+    return mid(m_string, index, len);
+}
+
+// the same columns taken from str, a copy of the text converted
+// character for character
+QString TermString::mid(const QString & str, int index, int len)
 {
     if (index < 0) {
         return QString();
@@ -141,18 +148,18 @@ QString TermString::mid(int index, int len)
         startpos = m_index.at(index-1);
     }
     if (len == -1) {
-        return m_string.mid(startpos,-1);
+        return str.mid(startpos,-1);
     }
     int index2 = index+len < m_index.size() ? index+len - 1 : m_index.size() - 1;
     int endpos = m_index.at(index2);
     if (index2 > 0 && index2 < (m_index.size() - 1) && m_index.at(index2+1) == -1) {
         //qDebug("TermString::mid: end pos is in the middle of a char");
-        return mid(index, len - 1);
+        return mid(str, index, len - 1);
     }
     if (endpos == -1) {
         endpos = m_index.at(index2-1);
     }
-    return m_string.mid(startpos, endpos-startpos + 1);
+    return str.mid(startpos, endpos-startpos + 1);
 }
 
 int TermString::length()
@@ -29,6 +29,7 @@ public:
     void remove(int index, int length);
     int length();
     QString mid(int index, int len);
+    QString mid(const QString & str, int index, int len);
     QString string();
     int beginIndex(int pos);
     int pos(int index);
@@ -0,0 +1,78 @@
+#include "testcrc.h"
+#include "zmodemcrc.h"
+#include "ssh/crc32.h"
+
+using namespace QTerm;
+
+// every length up to a few slices, at every alignment
+static const int MaxLength = 80;
+static const int MaxOffset = 8;
+
+void TestCrc::initTestCase()
+{
+    qsrand(27);
+    data.resize(MaxLength + MaxOffset);
+    for (int i = 0; i < data.size(); i++)
+        data[i] = char(qrand());
+    // the bytes Zmodem escapes and both ends of the range
+    data[0] = char(0x18);
+    data[1] = char(0xff);
+    data[2] = char(0x00);
+}
+
+void TestCrc::testCrc16()
+{
+    for (int offset = 0; offset < MaxOffset; offset++) {
+        const uchar * buf = (const uchar *) data.constData() + offset;
+        for (int len = 0; len <= MaxLength; len++) {
+            uint crc = 0;
+            for (int i = 0; i < len; i++)
+                crc = updcrc(buf[i], crc);
+            QCOMPARE(updcrc16(0, buf, len) & 0xffff, crc & 0xffff);
+        }
+    }
+}
+
+// blocks are chained, the register coming in is not always zero
+void TestCrc::testCrc16Seeded()
+{
+    const uchar * buf = (const uchar *) data.constData();
+    for (int len = 0; len <= MaxLength; len++) {
+        uint crc = 0x1d0f;
+        for (int i = 0; i < len; i++)
+            crc = updcrc(buf[i], crc);
+        QCOMPARE(updcrc16(0x1d0f, buf, len) & 0xffff, crc & 0xffff);
+        uint split = updcrc16(updcrc16(0x1d0f, buf, len / 2), buf + len / 2, len - len / 2);
+        QCOMPARE(split & 0xffff, crc & 0xffff);
+    }
+}
+
+void TestCrc::testCrc32()
+{
+    for (int offset = 0; offset < MaxOffset; offset++) {
+        const uchar * buf = (const uchar *) data.constData() + offset;
+        for (int len = 0; len <= MaxLength; len++) {
+            ulong crc = 0xffffffff;
+            for (int i = 0; i < len; i++)
+                crc = UPDC32(buf[i], crc);
+            QCOMPARE(updcrc32(0xffffffff, buf, len) & 0xffffffff, crc & 0xffffffff);
+        }
+    }
+}
+
+// the same polynomial, started from zero and not inverted
+void TestCrc::testSshCrc32()
+{
+    for (int offset = 0; offset < MaxOffset; offset++) {
+        const uchar * buf = (const uchar *) data.constData() + offset;
+        for (int len = 0; len <= MaxLength; len++) {
+            ulong crc = 0;
+            for (int i = 0; i < len; i++)
+                crc = UPDC32(buf[i], crc);
+            QCOMPARE((ulong) ssh_crc32(buf, len), crc & 0xffffffff);
+        }
+    }
+}
+
+QTEST_MAIN(TestCrc)
+#include "testcrc.moc"
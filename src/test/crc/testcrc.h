@@ -0,0 +1,21 @@
+#ifndef TEST_CRC_H
+#define TEST_CRC_H
+#include <QtTest>
+
+namespace QTerm
+{
+class TestCrc : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void testCrc16();
+    void testCrc16Seeded();
+    void testCrc32();
+    void testSshCrc32();
+private:
+    QByteArray data;
+};
+
+} // namespace QTerm
+#endif // TEST_CRC_H
@@ -0,0 +1,107 @@
+#include "testsiteindex.h"
+#include "qtermsiteindex.h"
+
+using namespace QTerm;
+
+static const char * const Smth = "{11111111-1111-1111-1111-111111111111}";
+static const char * const Ptt = "{22222222-2222-2222-2222-222222222222}";
+static const char * const Lily = "{33333333-3333-3333-3333-333333333333}";
+static const char * const Short = "{44444444-4444-4444-4444-444444444444}";
+
+// an address book as Global keeps it, the default site included
+static const char * const Address =
+    "<addresslist>"
+    "<folder name=\"Taiwan\"><addsite uuid=\"{22222222-2222-2222-2222-222222222222}\"/></folder>"
+    "<site uuid=\"{00000000-0000-0000-0000-000000000000}\" name=\"default\" addr=\"\" user=\"\"/>"
+    "<site uuid=\"{11111111-1111-1111-1111-111111111111}\" name=\"newsmth\" addr=\"bbs.newsmth.net\" user=\"guest\"/>"
+    "<site uuid=\"{22222222-2222-2222-2222-222222222222}\" name=\"ptt\" addr=\"ptt.cc\" user=\"guest\"/>"
+    "<site uuid=\"{33333333-3333-3333-3333-333333333333}\" name=\"lilybbs\" addr=\"lilybbs.net\" user=\"\"/>"
+    "<site uuid=\"{44444444-4444-4444-4444-444444444444}\" name=\"smth\" addr=\"smth.org\" user=\"guest\"/>"
+    "</addresslist>";
+
+void TestSiteIndex::init()
+{
+    QVERIFY(doc.setContent(QString(Address)));
+    index = new SiteIndex;
+    index->build(doc);
+}
+
+void TestSiteIndex::cleanup()
+{
+    delete index;
+}
+
+QDomElement TestSiteIndex::site(const QString & uuid)
+{
+    QDomNodeList siteList = doc.elementsByTagName("site");
+    for (int i = 0; i < siteList.count(); i++) {
+        QDomElement element = siteList.at(i).toElement();
+        if (element.attribute("uuid") == uuid)
+            return element;
+    }
+    return QDomElement();
+}
+
+// one letter finds the words it starts, not those it is inside of
+void TestSiteIndex::testOneLetter()
+{
+    QCOMPARE(index->search("b"), QStringList() << Smth);
+    QCOMPARE(index->search("n"), QStringList() << Smth << Lily);
+    QVERIFY(index->search("w").isEmpty());
+}
+
+void TestSiteIndex::testTwoLetters()
+{
+    QCOMPARE(index->search("pt"), QStringList() << Ptt);
+    // equal scores go by name
+    QCOMPARE(index->search("gu"), QStringList() << Smth << Ptt << Short);
+    QCOMPARE(index->search("gu", 2), QStringList() << Smth << Ptt);
+    QVERIFY(index->search("tp").isEmpty());
+}
+
+void TestSiteIndex::testTypo()
+{
+    QCOMPARE(index->search("newsmht"), QStringList() << Smth);
+    QCOMPARE(index->search("lilybs"), QStringList() << Lily);
+    QCOMPARE(index->search("NewSmth"), QStringList() << Smth);
+}
+
+// the whole name first, then the site it is part of
+void TestSiteIndex::testRanking()
+{
+    QCOMPARE(index->search("smth"), QStringList() << Short << Smth);
+    QCOMPARE(index->search("net"), QStringList() << Lily << Smth);
+}
+
+void TestSiteIndex::testTags()
+{
+    QCOMPARE(index->search("taiwan"), QStringList() << Ptt);
+    // changed sites keep the folders they are in
+    QDomElement ptt = site(Ptt);
+    ptt.setAttribute("addr", "ptt2.cc");
+    index->setSite(ptt);
+    QCOMPARE(index->search("taiwan"), QStringList() << Ptt);
+    QCOMPARE(index->search("ptt2"), QStringList() << Ptt);
+}
+
+void TestSiteIndex::testDefaultSite()
+{
+    QVERIFY(index->search("default").isEmpty());
+}
+
+void TestSiteIndex::testUpdate()
+{
+    QDomElement lily = site(Lily);
+    lily.setAttribute("name", "lily");
+    lily.setAttribute("addr", "bbs.nju.edu.cn");
+    index->setSite(lily);
+    QCOMPARE(index->search("net"), QStringList() << Smth);
+    QCOMPARE(index->search("nju"), QStringList() << Lily);
+
+    index->removeSite(Smth);
+    QVERIFY(index->search("newsmth").isEmpty());
+    QCOMPARE(index->search("gu"), QStringList() << Ptt << Short);
+}
+
+QTEST_MAIN(TestSiteIndex)
+#include "testsiteindex.moc"
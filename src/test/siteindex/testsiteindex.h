@@ -0,0 +1,29 @@
+#ifndef TEST_SITEINDEX_H
+#define TEST_SITEINDEX_H
+#include <QtTest>
+#include <QtXml/QDomDocument>
+
+namespace QTerm
+{
+class SiteIndex;
+class TestSiteIndex : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void cleanup();
+    void testOneLetter();
+    void testTwoLetters();
+    void testTypo();
+    void testRanking();
+    void testTags();
+    void testDefaultSite();
+    void testUpdate();
+private:
+    QDomElement site(const QString & uuid);
+    QDomDocument doc;
+    SiteIndex * index;
+};
+
+} // namespace QTerm
+#endif // TEST_SITEINDEX_H
@@ -0,0 +1,120 @@
+#include "testtrigger.h"
+#include "qtermtrigger.h"
+#include "qtermbuffer.h"
+
+using namespace QTerm;
+
+void TestTrigger::testParse()
+{
+    QList<Trigger::Rule> rules = Trigger::parse(
+        "# log in as guest\n"
+        "  welcome => send:guest^M  \n"
+        "\n"
+        "new mail => Notify:\n"
+        "a=>b => script:onArrow\n");
+    QCOMPARE(rules.size(), 3);
+
+    QCOMPARE(rules.at(0).pattern, QString("welcome"));
+    QVERIFY(!rules.at(0).regex);
+    QCOMPARE(int(rules.at(0).action), int(Trigger::Send));
+    QCOMPARE(rules.at(0).argument, QString("guest^M"));
+
+    // action names ignore case, an empty text shows the line
+    QCOMPARE(rules.at(1).pattern, QString("new mail"));
+    QCOMPARE(int(rules.at(1).action), int(Trigger::Notify));
+    QVERIFY(rules.at(1).argument.isEmpty());
+
+    // the last arrow splits, so patterns may hold one
+    QCOMPARE(rules.at(2).pattern, QString("a=>b"));
+    QCOMPARE(int(rules.at(2).action), int(Trigger::Script));
+    QCOMPARE(rules.at(2).argument, QString("onArrow"));
+}
+
+void TestTrigger::testParseRegex()
+{
+    QList<Trigger::Rule> rules = Trigger::parse(
+        "re:press\\s+any key => send:^M\n"
+        "re: => send:x\n"
+        "regular => send:x\n");
+    QCOMPARE(rules.size(), 2);
+    QVERIFY(rules.at(0).regex);
+    QCOMPARE(rules.at(0).pattern, QString("press\\s+any key"));
+    QCOMPARE(rules.at(0).argument, QString("^M"));
+    // only the prefix makes a regular expression
+    QVERIFY(!rules.at(1).regex);
+    QCOMPARE(rules.at(1).pattern, QString("regular"));
+}
+
+void TestTrigger::testParseBad()
+{
+    QList<Trigger::Rule> rules = Trigger::parse(
+        "no action here\n"
+        "=> send:x\n"
+        "hello => shout:loud\n"
+        "hello =>\n"
+        "hello => script:\n"
+        "hello => send:ok\n");
+    QCOMPARE(rules.size(), 1);
+    QCOMPARE(rules.at(0).argument, QString("ok"));
+    QVERIFY(Trigger::parse(QString()).isEmpty());
+}
+
+// a rule fires once for each revision of a line it matches
+void TestTrigger::testCheck()
+{
+    Trigger trigger;
+    trigger.setRules(Trigger::parse(
+        "WELCOME => notify:\n"
+        "re:press\\s+any => send:^M\n"));
+    QCOMPARE(int(trigger.rule(1).action), int(Trigger::Send));
+
+    Buffer buffer(24, 80, 0);
+    QVERIFY(trigger.check(&buffer).isEmpty());
+
+    buffer.setBuffer("Welcome to BBS", 0);
+    QList<Trigger::Match> matches = trigger.check(&buffer);
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches.at(0).rule, 0);
+    QVERIFY(matches.at(0).text.startsWith("Welcome to BBS"));
+    QVERIFY(trigger.check(&buffer).isEmpty());
+
+    buffer.moveCursor(0, 1);
+    buffer.setBuffer("Press  any key", 0);
+    matches = trigger.check(&buffer);
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches.at(0).rule, 1);
+}
+
+// rules replaced on a live window leave the lines shown alone
+void TestTrigger::testMarkChecked()
+{
+    Trigger trigger;
+    Buffer buffer(24, 80, 0);
+    buffer.setBuffer("Press any key", 0);
+    trigger.setRules(Trigger::parse("press any => send:^M\n"));
+    QCOMPARE(trigger.check(&buffer).size(), 1);
+
+    trigger.setRules(Trigger::parse("press any => send:^M\n"));
+    trigger.markChecked(&buffer);
+    QVERIFY(trigger.check(&buffer).isEmpty());
+
+    // a line changed afterwards is matched again
+    buffer.moveCursor(0, 0);
+    buffer.setBuffer("Press any key", 0);
+    QCOMPARE(trigger.check(&buffer).size(), 1);
+}
+
+void TestTrigger::testInvalidRegex()
+{
+    Trigger trigger;
+    trigger.setRules(Trigger::parse(
+        "re:( => send:x\n"
+        "hello => send:y\n"));
+    QCOMPARE(trigger.rule(0).argument, QString("y"));
+
+    trigger.clear();
+    QVERIFY(trigger.isEmpty());
+}
+
+QTEST_MAIN(TestTrigger)
+#include "testtrigger.moc"
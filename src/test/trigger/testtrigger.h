@@ -0,0 +1,20 @@
+#ifndef TEST_TRIGGER_H
+#define TEST_TRIGGER_H
+#include <QtTest>
+
+namespace QTerm
+{
+class TestTrigger : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testParse();
+    void testParseRegex();
+    void testParseBad();
+    void testCheck();
+    void testMarkChecked();
+    void testInvalidRegex();
+};
+
+} // namespace QTerm
+#endif // TEST_TRIGGER_H
@@ -52,8 +52,6 @@ QT_BEGIN_NAMESPACE
 #define IsSecondByteRange2(c)        (InRange((c), 0xA1, 0xFE))
 #define IsSecondByte(c)        (IsSecondByteRange1(c) || IsSecondByteRange2(c))
 
-#define        QValidChar(u)        ((u) ? QChar((ushort)(u)) : QChar(QChar::ReplacementCharacter))
-
 
 int UAOCodec::_mibEnum()
 {
@@ -69,11 +67,6 @@ QByteArray UAOCodec::_name()
  * ucs4 to big5hkscs convert routing
  */
 
-typedef struct {
-    ushort index; /* index into big table */
-    ushort used;  /* bitmask of used entries */
-} Summary16;
-
 static const ushort big5_to_ucs[] = 
 {
 19991, 20002, 20012, 20053, 20066, 20106, 20144, 20203, 20205, 20220,
@@ -15597,55 +15590,16 @@ static const uchar ucs_to_big5[][2] =
     {0x00,0x00}
 };
 
-static int qt_Big5ToUnicode(const uchar *s, uint *pwc)
+/*
+ * Both tables are indexed directly: big5_to_ucs by the byte pair
+ * (191 second bytes per lead byte), ucs_to_big5 by the BMP code point.
+ * A zero entry means no mapping.
+ */
+static inline ushort qt_Big5ToUnicode(uchar c1, uchar c2)
 {
-    uchar c1 = s[0];
-    int idx;
-    ushort wc = 0xfffd;
-
-    if ((c1 >= 0x81 && c1 <= 0xfe)) {
-        uchar c2 = s[1];
-
-        if (c2 < 0x40 || c2 > 0xfe 
-                || (idx = ((c1 - 0x81) * 191) + (c2 - 0x40),
-                    (wc = big5_to_ucs[idx]) == 0))
-            return 0;
-        else {
-            *pwc = (uint) wc;
-            return 2;
-        }
-
-    } else if (c1 < 0x80) {
-        *pwc = (uint) c1;
-        return 1;
-    }
-    return 0;
-}
-
-static int qt_UnicodeToBig5(uint wc, uchar *r)
-{
-    const Summary16 *summary = NULL;
-    const uchar * c;
-    if (wc < 0x80) {
-        r[0] = (uchar) wc;
-        return 1;
-    }
-    else {
-        if (wc >= 0 && wc <= 65535){
-            c = ucs_to_big5[wc];
-            if (c [0] == '\0')
-                return 0;
-            if (c [1] != 0) {
-                r[0] = c[0];
-                r[1] = c[1];
-                return 2;
-            } else {  // (c [1] == 0)
-                r[0] = c[0];
-                return 1;
-            }
-        }
-    }
-    return 0;
+    if (!IsSecondByte(c2))
+        return 0;
+    return big5_to_ucs[(c1 - 0x81) * 191 + (c2 - 0x40)];
 }
 
 QString UAOCodec::convertToUnicode(const char* chars, int len, ConverterState *state) const
@@ -15663,45 +15617,53 @@ QString UAOCodec::convertToUnicode(const char* chars, int len, ConverterState *s
     int invalid = 0;
 
     //qDebug("UAOCodec::toUnicode(const char* chars = \"%s\", int len = %d)", chars, len);
+    // every byte ends at most one character
     QString result;
-    for (int i=0; i<len; i++) {
-        uchar ch = chars[i];
-        switch (nbuf) {
-        case 0:
-            if (IsLatin(ch)) {
-                // ASCII
-                result += QLatin1Char(ch);
-            } else if (IsFirstByte(ch)) {
-                // Big5-ETen
-                buf[0] = ch;
-                nbuf = 1;
-            } else {
-                // Invalid
-                result += replacement;
-                ++invalid;
-            }
+    result.resize(len);
+    QChar *out = result.data();
+    const uchar *p = (const uchar *)chars;
+    const uchar *end = p + len;
+
+    if (nbuf == 1 && p < end) {
+        // second half of a character split across calls
+        ushort u = qt_Big5ToUnicode(buf[0], *p++);
+        if (u != 0)
+            *out++ = QChar(u);
+        else {
+            *out++ = replacement;
+            ++invalid;
+        }
+        nbuf = 0;
+    }
+    while (p < end) {
+        // ASCII
+        while (p < end && IsLatin(*p))
+            *out++ = QLatin1Char(*p++);
+        if (p == end)
             break;
-        case 1:
-            if (IsSecondByte(ch)) {
-                // Big5-ETen
-                uint u;
-                buf[1] = ch;
-                if (qt_Big5ToUnicode(buf, &u) == 2)
-                    result += QValidChar(u);
-                else {
-                    // Error
-                    result += replacement;
-                    ++invalid;
-                }
-            } else {
+
+        uchar ch = *p++;
+        if (!IsFirstByte(ch)) {
+            // Invalid
+            *out++ = replacement;
+            ++invalid;
+        } else if (p == end) {
+            buf[0] = ch;
+            nbuf = 1;
+        } else {
+            // Big5-ETen
+            ushort u = qt_Big5ToUnicode(ch, *p++);
+            if (u != 0)
+                *out++ = QChar(u);
+            else {
                 // Error
-                result += replacement;
+                *out++ = replacement;
                 ++invalid;
             }
-            nbuf = 0;
-            break;
         }
     }
+    result.resize(out - result.constData());
+
     if (state) {
         state->remainingChars = nbuf;
         state->state_data[0] = buf[0];
@@ -15728,11 +15690,13 @@ QByteArray UAOCodec::convertFromUnicode(const QChar *uc, int len, ConverterState
     uchar* cursor = (uchar*)rstr.data();
     for (int i=0; i<len; i++) {
         ushort ch = uc[i].unicode();
-        uchar c[2];
         if (ch < 0x80) {
             // ASCII
             *cursor++ = ch;
-        } else if (qt_UnicodeToBig5(ch, c) == 2 && c[0] >= 0x81 && c[0] <= 0xfe) {
+            continue;
+        }
+        const uchar *c = ucs_to_big5[ch];
+        if (c[0] >= 0x81 && c[0] <= 0xfe && c[1] != 0) {
             *cursor++ = c[0];
             *cursor++ = c[1];
         } else {
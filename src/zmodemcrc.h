@@ -0,0 +1,35 @@
+#ifndef ZMODEMCRC_H
+#define ZMODEMCRC_H
+
+#include <QtCore/QtGlobal>
+
+namespace QTerm
+{
+
+extern unsigned short crctab[256];
+extern unsigned long cr3tab[256];
+
+/*
+ * updcrc macro derived from article Copyright (C) 1986 Stephen Satchell.
+ *  NOTE: First argument must be in range 0 to 255.
+ *        Second argument is referenced twice.
+ *
+ * Programmers may incorporate any or all code into their programs,
+ * giving proper credit within the source. Publication of the
+ * source routines is permitted so long as proper credit is given
+ * to Stephen Satchell, Satchell Evaluations and Chuck Forsberg,
+ * Omen Technology.
+ */
+
+#define updcrc(cp, crc) ( crctab[((crc >> 8) & 255)] ^ (crc << 8) ^ cp)
+
+#define UPDC32(b, c) (cr3tab[((int)c ^ b) & 0xff] ^ ((c >> 8) & 0x00FFFFFF))
+
+/* the same as the macros run over every byte of buf, for Zmodem and
+ * the Y/Xmodem blocks */
+uint updcrc16(uint crc, const uchar *buf, int len);
+ulong updcrc32(ulong crc, const uchar *buf, int len);
+
+} // namespace QTerm
+
+#endif // ZMODEMCRC_H
@@ -0,0 +1,237 @@
+#include "zmodemio.h"
+#include "zmodemcrc.h"
+
+#include <errno.h>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
+#include <QtCore/QMutexLocker>
+
+namespace QTerm
+{
+
+ZmodemIO::ZmodemIO(QObject * parent)
+    : QThread(parent), m_quit(false), m_error(0),
+      m_writeFile(NULL), m_filling(), m_flushing(),
+      m_readFile(NULL), m_reading(false), m_readEof(false),
+      m_readAhead(), m_current(), m_readPos(0),
+      m_crcName(), m_crcGeneration(0)
+{
+}
+
+ZmodemIO::~ZmodemIO()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_crcGeneration++;
+    m_work.wakeOne();
+    m_mutex.unlock();
+    wait();
+}
+
+void ZmodemIO::run()
+{
+    m_mutex.lock();
+    while (!m_quit) {
+        if (!m_flushing.isEmpty()) {
+            QByteArray block = m_flushing;
+            FILE * file = m_writeFile;
+            m_mutex.unlock();
+            int err = 0;
+            if (fwrite(block.constData(), 1, block.size(), file) != (size_t) block.size())
+                err = errno;
+            m_mutex.lock();
+            if (err != 0 && m_error == 0)
+                m_error = err;
+            m_flushing.clear();
+            m_done.wakeAll();
+        } else if (m_readFile != NULL && !m_readEof && m_readAhead.size() < ReadAhead) {
+            FILE * file = m_readFile;
+            m_reading = true;
+            m_mutex.unlock();
+            QByteArray block(BlockSize, 0);
+            size_t n = fread(block.data(), 1, BlockSize, file);
+            int err = ferror(file) ? errno : 0;
+            m_mutex.lock();
+            m_reading = false;
+            block.resize(n);
+            if (n > 0)
+                m_readAhead << block;
+            if (n < (size_t) BlockSize)
+                m_readEof = true;
+            if (err != 0 && m_error == 0)
+                m_error = err;
+            m_done.wakeAll();
+            emit dataReady();
+        } else if (!m_crcName.isEmpty()) {
+            QByteArray name = m_crcName;
+            uint generation = m_crcGeneration;
+            m_crcName.clear();
+            m_mutex.unlock();
+            computeCrc(name, generation);
+            m_mutex.lock();
+        } else {
+            m_work.wait(&m_mutex);
+        }
+    }
+    m_mutex.unlock();
+}
+
+/* Called with m_mutex held, before work is queued. */
+void ZmodemIO::startWorker()
+{
+    if (!isRunning())
+        start();
+}
+
+void ZmodemIO::startWrite(FILE * file)
+{
+    QMutexLocker locker(&m_mutex);
+    startWorker();
+    m_writeFile = file;
+    m_error = 0;
+    m_filling.clear();
+    m_filling.reserve(BlockSize);
+}
+
+int ZmodemIO::write(const uchar * buf, int len)
+{
+    m_filling.append((const char *) buf, len);
+    if (m_filling.size() >= BlockSize)
+        flushBlock();
+    return error() == 0 ? 0 : -1;
+}
+
+/* Hand the filled block to the worker, waiting only if it is still busy
+ * with the previous one. */
+void ZmodemIO::flushBlock()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_flushing.isEmpty())
+        m_done.wait(&m_mutex);
+    m_flushing = m_filling;
+    m_filling = QByteArray();
+    m_filling.reserve(BlockSize);
+    m_work.wakeOne();
+}
+
+int ZmodemIO::finishWrite()
+{
+    if (!m_filling.isEmpty())
+        flushBlock();
+    QMutexLocker locker(&m_mutex);
+    while (!m_flushing.isEmpty())
+        m_done.wait(&m_mutex);
+    if (m_writeFile != NULL && fflush(m_writeFile) != 0 && m_error == 0)
+        m_error = errno;
+    m_writeFile = NULL;
+    m_filling.clear();
+    return m_error == 0 ? 0 : -1;
+}
+
+void ZmodemIO::startRead(FILE * file, long offset)
+{
+    QMutexLocker locker(&m_mutex);
+    /* the worker must be done with the FILE before it is moved */
+    while (m_reading)
+        m_done.wait(&m_mutex);
+    startWorker();
+    m_readFile = file;
+    m_readEof = false;
+    m_readAhead.clear();
+    m_current.clear();
+    m_readPos = 0;
+    m_error = 0;
+    fseek(file, offset, SEEK_SET);
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fileno(file), offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    m_work.wakeOne();
+}
+
+/* Point *data at the next unread bytes and return how many there are,
+ * never waiting for the worker: -1 means the next block is still being
+ * read and dataReady() will be emitted when it is in. */
+int ZmodemIO::peek(const uchar ** data)
+{
+    if (m_readPos >= m_current.size()) {
+        QMutexLocker locker(&m_mutex);
+        m_readPos = 0;
+        m_current.clear();
+        if (m_readAhead.isEmpty()) {
+            *data = NULL;
+            return m_readEof || m_readFile == NULL ? 0 : -1;
+        }
+        m_current = m_readAhead.takeFirst();
+        m_work.wakeOne();
+    }
+    *data = (const uchar *) m_current.constData() + m_readPos;
+    return m_current.size() - m_readPos;
+}
+
+void ZmodemIO::consume(int len)
+{
+    m_readPos += len;
+}
+
+void ZmodemIO::stopRead()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_reading)
+        m_done.wait(&m_mutex);
+    m_readFile = NULL;
+    m_readAhead.clear();
+    m_current.clear();
+    m_readPos = 0;
+}
+
+void ZmodemIO::startCrc(const QByteArray & name)
+{
+    QMutexLocker locker(&m_mutex);
+    startWorker();
+    m_crcName = name;
+    m_crcGeneration++;
+    m_work.wakeOne();
+}
+
+/* A result is only delivered for the latest startCrc(); emitting with the
+ * lock held is fine, the receiver is on the GUI thread and gets it queued. */
+void ZmodemIO::computeCrc(const QByteArray & name, uint generation)
+{
+    FILE * file = fopen(name.constData(), "rb");
+    ulong crc = 0xffffffff;
+    if (file == NULL) {
+        QMutexLocker locker(&m_mutex);
+        if (!m_quit && generation == m_crcGeneration)
+            emit crcReady(0);
+        return;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    QByteArray block(BlockSize, 0);
+    size_t n;
+    while ((n = fread(block.data(), 1, BlockSize, file)) > 0) {
+        crc = updcrc32(crc, (const uchar *) block.constData(), n);
+        QMutexLocker locker(&m_mutex);
+        if (m_quit || generation != m_crcGeneration) {
+            fclose(file);
+            return;
+        }
+    }
+    fclose(file);
+    QMutexLocker locker(&m_mutex);
+    if (!m_quit && generation == m_crcGeneration)
+        emit crcReady(~crc & 0xffffffff);
+}
+
+int ZmodemIO::error()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_error;
+}
+
+} // namespace QTerm
+
+#include "moc_zmodemio.cpp"
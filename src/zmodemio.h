@@ -0,0 +1,94 @@
+#ifndef ZMODEMIO_H
+#define ZMODEMIO_H
+
+#include <stdio.h>
+
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+
+namespace QTerm
+{
+
+/*
+ * File access for Zmodem transfers, done on a worker thread so that the
+ * protocol state machine on the GUI thread never waits for the disk
+ * except when a written block is still being flushed as the next fills.
+ * The thread is started by the first transfer that needs it.
+ *
+ * Received data is collected into large blocks; while one block is being
+ * written by the worker the next one fills.  Sent data is read ahead in
+ * large blocks and handed out with peek()/consume(); when the worker has
+ * not read that far yet peek() says so and dataReady() follows.  The
+ * whole-file CRC asked for by ZCRC is computed in the background and
+ * delivered through crcReady().
+ *
+ * The FILE handles stay owned by the caller, stopRead()/finishWrite()
+ * must be called before they are closed.
+ */
+class ZmodemIO : public QThread
+{
+    Q_OBJECT
+public:
+    ZmodemIO(QObject * parent = 0);
+    ~ZmodemIO();
+
+    /* receive */
+    void startWrite(FILE * file);
+    int write(const uchar * buf, int len);
+    int finishWrite();
+
+    /* send */
+    void startRead(FILE * file, long offset);
+    /* bytes at *data, 0 at end of file, -1 until dataReady() */
+    int peek(const uchar ** data);
+    void consume(int len);
+    void stopRead();
+
+    void startCrc(const QByteArray & name);
+
+    /* errno of the first failed read or write */
+    int error();
+
+signals:
+    void dataReady();
+    void crcReady(ulong crc);
+
+protected:
+    void run();
+
+private:
+    enum {
+        BlockSize = 256 * 1024,
+        ReadAhead = 2
+    };
+    void startWorker();
+    void flushBlock();
+    void computeCrc(const QByteArray & name, uint generation);
+
+    QMutex m_mutex;
+    QWaitCondition m_work;  /* wakes the worker */
+    QWaitCondition m_done;  /* wakes the GUI thread */
+    bool m_quit;
+    int m_error;
+
+    FILE * m_writeFile;
+    QByteArray m_filling;   /* GUI thread only */
+    QByteArray m_flushing;  /* handed to the worker */
+
+    FILE * m_readFile;
+    bool m_reading;
+    bool m_readEof;
+    QList<QByteArray> m_readAhead;
+    QByteArray m_current;   /* GUI thread only */
+    int m_readPos;
+
+    QByteArray m_crcName;
+    uint m_crcGeneration;
+};
+
+} // namespace QTerm
+
+#endif // ZMODEMIO_H